@@ -3,17 +3,69 @@
 layout(binding = 0) uniform sampler2D accum_tex;
 layout(binding = 1) uniform sampler2D reveal_tex;
 
+#ifdef BILATERAL_UPSAMPLE
+// the transparent pass ran at a lower resolution with its own color modulation target
+layout(binding = 2) uniform sampler2D modulation_tex;
+layout(binding = 3) uniform sampler2D lowres_depth_tex;
+layout(binding = 4) uniform sampler2D depth_tex;
+
+// blended with GL_ONE, GL_SRC1_COLOR, so the scene behind is modulated and revealed in one step
+layout(location = 0, index = 0) out vec4 color;
+layout(location = 0, index = 1) out vec4 factor;
+
+const float DEPTH_EPSILON = 0.0001f;
+#else
 layout(location = 0) out vec4 color;
+#endif
 
 void main() {
     ivec2 coords = ivec2(gl_FragCoord.xy);
+#ifdef BILATERAL_UPSAMPLE
+    // bilinear between the four nearest low resolution texels, each scaled down by how far its depth is
+    // from this pixel's, so fur does not bleed across silhouettes
+    ivec2 low_size = textureSize(accum_tex, 0);
+    vec2 low_pos = gl_FragCoord.xy * vec2(low_size) / vec2(textureSize(depth_tex, 0)) - 0.5f;
+    ivec2 base = ivec2(floor(low_pos));
+    vec2 f = low_pos - vec2(base);
+    float depth = texelFetch(depth_tex, coords, 0).r;
+
+    vec4 accum = vec4(0);
+    float reveal = 0;
+    vec3 modulation = vec3(0);
+    float total = 0;
+    for (int i = 0; i < 4; ++i) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 texel = clamp(base + offset, ivec2(0), low_size - 1);
+        vec2 bilinear = mix(1 - f, f, vec2(offset));
+        float weight = bilinear.x * bilinear.y
+                     / (DEPTH_EPSILON + abs(texelFetch(lowres_depth_tex, texel, 0).r - depth));
+        accum += weight * texelFetch(accum_tex, texel, 0);
+        reveal += weight * texelFetch(reveal_tex, texel, 0).r;
+        modulation += weight * texelFetch(modulation_tex, texel, 0).rgb;
+        total += weight;
+    }
+    accum /= total;
+    reveal /= total;
+    modulation /= total;
+    if (reveal > 0.999 && all(greaterThan(modulation, vec3(0.999)))) discard;
+#elif defined(MOMENT_BASED)
+    // reveal_tex holds the optical depth summed by the moment pass
+    float reveal = exp(-texelFetch(reveal_tex, coords, 0).r);
+    if (reveal > 0.999) discard;
+    vec4 accum = texelFetch(accum_tex, coords, 0);
+#else
     float reveal = texelFetch(reveal_tex, coords, 0).r;
     if (reveal > 0.999) discard;
     vec4 accum = texelFetch(accum_tex, coords, 0);
+#endif
     if (isinf(abs(accum.r)) || isinf(abs(accum.g)) || isinf(abs(accum.b))) {
         accum.rgb = vec3(accum.a);
     }
     float epsilon = 0.00001f;
     color.rgb = accum.rgb / max(accum.a, epsilon);
     color.a = 1-reveal;
-}
\ No newline at end of file
+#ifdef BILATERAL_UPSAMPLE
+    color.rgb *= color.a;
+    factor = vec4(modulation * reveal, 1);
+#endif
+}
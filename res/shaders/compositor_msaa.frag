@@ -0,0 +1,28 @@
+#version 430 core
+
+// multisampled oit targets, composited sample by sample and averaged into a single sample target
+layout(binding = 0) uniform sampler2DMS accum_tex;
+layout(binding = 1) uniform sampler2DMS reveal_tex;
+layout(binding = 2) uniform sampler2DMS color_tex;
+
+uniform layout(location = 0) int sample_count;
+
+layout(location = 0) out vec4 color;
+
+void main() {
+    ivec2 coords = ivec2(gl_FragCoord.xy);
+    float epsilon = 0.00001f;
+    vec3 resolved = vec3(0);
+    for (int i = 0; i < sample_count; ++i) {
+        vec3 opaque = texelFetch(color_tex, coords, i).rgb;
+        float reveal = texelFetch(reveal_tex, coords, i).r;
+        vec4 accum = texelFetch(accum_tex, coords, i);
+        if (isinf(abs(accum.r)) || isinf(abs(accum.g)) || isinf(abs(accum.b))) {
+            accum.rgb = vec3(accum.a);
+        }
+        // the same over operator the single sample compositor blends with
+        vec3 transparent = accum.rgb / max(accum.a, epsilon);
+        resolved += mix(transparent, opaque, reveal);
+    }
+    color = vec4(resolved / sample_count, 1);
+}
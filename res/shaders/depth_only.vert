@@ -0,0 +1,33 @@
+#version 430 core
+#ifdef HAS_DRAW_PARAMETERS
+#extension GL_ARB_shader_draw_parameters : require
+// the batch puts the draw's index in baseInstance, the whole buffer is bound
+#define DRAW_INDEX gl_BaseInstanceARB
+#else
+// one draw at a time, each with the buffer range bound at its entry
+#define DRAW_INDEX 0
+#endif
+
+in layout(location = 0) vec3 position;
+
+struct DrawData {
+    mat4 MVP;
+    mat4 model;
+    mat3 normal_matrix;
+    // surface, fur shell and fur fin material, see MaterialTable
+    uvec4 materials;
+    vec4 padding[4];
+};
+
+layout(std430, binding = 0) readonly buffer DrawDataBuffer {
+    DrawData draws[];
+};
+
+// must match simple_mdi.vert exactly so the colour pass can test GL_EQUAL
+invariant gl_Position;
+
+void main()
+{
+    DrawData draw = draws[DRAW_INDEX];
+    gl_Position = draw.MVP * vec4(position, 1.0f);
+}
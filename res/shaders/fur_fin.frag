@@ -12,43 +12,62 @@ in layout(location = 2) vec3 world_pos;
 in layout(location = 3) vec3 tangent_in;
 in layout(location = 4) float layer_dist;
 in layout(location = 5) float alpha;
+in layout(location = 6) flat uint material;
 
 
-uniform layout(location = 1) mat3 normal_matrix;
-uniform layout(location = 2) vec3 camera_pos;
-uniform PointLightSource point_light_sources[point_light_sources_len];
+// written once a frame, see FrameData in gamelogic.cpp
+layout(std140, binding = 0) uniform FrameData {
+    vec3 camera_pos;
+    vec3 wind;
+    PointLightSource point_light_sources[point_light_sources_len];
+};
+
+// slots of MaterialData
+#define MATERIAL_COLOR 0
+#define MATERIAL_ROUGHNESS 2
 
-layout(binding = 0) uniform sampler2D tex;
-layout(binding = 1) uniform sampler2D normal_map;
-layout(binding = 2) uniform sampler2D roughness_map;
-layout(binding = 4) uniform sampler2D turbulence;
+// material.glsl
+vec4 materialTextureGrad(uint material, int slot, vec2 uv, vec2 uv_dx, vec2 uv_dy);
 
 layout (location = 0) out vec4 modulation;
 layout (location = 1) out vec4 accumulation;
 layout (location = 2) out float revealage;
 
+// moment_oit.frag, writes the outputs for the active transparency backend
+void writeTransparency(vec4 color, vec3 base_color, float weight,
+                       out vec4 modulation, out vec4 accumulation, out float revealage);
+
 float rand(vec2 co) { return fract(sin(dot(co.xy, vec2(12.9898,78.233))) * 43758.5453); }
 float dither(vec2 uv) { return (rand(uv)*2.0-1.0) / 256.0; }
 
+// what is dropped over the 10 layers of fur_fin.geom stays under one 8 bit step, see fur_shell.frag
+const float MIN_COVERAGE = 1. / (255. * 10.);
+
 float attenuation(float distance){
     return 1 + 0.007*distance + 0.00013*distance*distance;
 }
 
 void main()
 {
+    // taken before the first discard, the lookups after it are in non-uniform control flow
+    vec2 uv_dx = dFdx(uv_in);
+    vec2 uv_dy = dFdy(uv_in);
+
+    if (alpha < MIN_COVERAGE) discard;
     vec4 color;
     vec3 mat_diff = vec3(1.,1.,1.);
     vec3 mat_spec = vec3(1.,1.,1.);
     vec3 normal = normalize(normal_in);
 
     // get the texture color.
-    vec4 frag_color = texture(tex, uv_in);
+    vec4 frag_color = materialTextureGrad(material, MATERIAL_COLOR, uv_in, uv_dx, uv_dy);
     // Find strand point visibility, turbulence texture gives the fur strands.
     color.a = frag_color.a * alpha;
+    if (color.a < MIN_COVERAGE) discard;
 
-    // hardcoded roughness location in texture
+    // hardcoded roughness location in texture, a single point so the top mip
     vec2 fin_roughness_uv = vec2(0.1,0.1);
-    float roughness = texture(roughness_map, fin_roughness_uv).x;
+    float roughness = materialTextureGrad(material, MATERIAL_ROUGHNESS, fin_roughness_uv, vec2(0), vec2(0)).x;
     float mat_shine = (5.f/(roughness*roughness));
 
     // base ambient intensity
@@ -95,14 +114,8 @@ void main()
     float root_darkening = (0.9 + 0.2*layer_dist*layer_dist);
     color.rgb = root_darkening * intensity * frag_color.rgb + reflective_intensity + dither(uv_in);
 
-    accumulation = color;
-
     float weight = 4e3*pow(1-gl_FragCoord.z, 3.);
     weight = clamp(weight, 3e-4, 1.);
 
-    accumulation.rgb *= color.a;
-    accumulation *= weight;
-    revealage = color.a;
-    modulation.rgb = accumulation.a * (1 - frag_color.rgb);
-    modulation.a = color.a;
+    writeTransparency(color, frag_color.rgb, weight, modulation, accumulation, revealage);
 }
\ No newline at end of file
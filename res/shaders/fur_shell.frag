@@ -11,40 +11,71 @@ in layout(location = 1) vec2 uv_in;
 in layout(location = 2) vec3 world_pos;
 in layout(location = 3) vec3 tangent_in;
 in layout(location = 4) float layer_dist;
+in layout(location = 6) flat uint material;
 
-uniform layout(location = 1) mat3 normal_matrix;
-uniform layout(location = 2) vec3 camera_pos;
-uniform PointLightSource point_light_sources[point_light_sources_len];
+// written once a frame, see FrameData in gamelogic.cpp
+layout(std140, binding = 0) uniform FrameData {
+    vec3 camera_pos;
+    vec3 wind;
+    PointLightSource point_light_sources[point_light_sources_len];
+};
+
+// slots of MaterialData
+#define MATERIAL_COLOR 0
+#define MATERIAL_NORMAL 1
+#define MATERIAL_ROUGHNESS 2
+#define MATERIAL_TURBULENCE 4
 
-layout(binding = 0) uniform sampler2D tex;
-layout(binding = 1) uniform sampler2D normal_map;
-layout(binding = 2) uniform sampler2D roughness_map;
-layout(binding = 4) uniform sampler2D turbulence;
+// material.glsl
+vec4 materialTextureGrad(uint material, int slot, vec2 uv, vec2 uv_dx, vec2 uv_dy);
 
+#ifdef ALPHA_TO_COVERAGE
+// drawn with the opaque pass, GL_SAMPLE_ALPHA_TO_COVERAGE turns alpha into covered samples
+layout (location = 0) out vec4 coverage_color;
+#else
 layout (location = 0) out vec4 modulation;
 layout (location = 1) out vec4 accumulation;
 layout (location = 2) out float revealage;
 
+// moment_oit.frag, writes the outputs for the active transparency backend
+void writeTransparency(vec4 color, vec3 base_color, float weight,
+                       out vec4 modulation, out vec4 accumulation, out float revealage);
+#endif
+
 float rand(vec2 co) { return fract(sin(dot(co.xy, vec2(12.9898,78.233))) * 43758.5453); }
 float dither(vec2 uv) { return (rand(uv)*2.0-1.0) / 256.0; }
 
+// Skipping a fragment of coverage a leaves a (1 - a) factor out of revealage and a weighted a out of
+// accumulation. Up to the 20 layers of fur_shell.geom can stack on a pixel, so this keeps the sum of what
+// is dropped under one 8 bit step. Between strands the coverage is 0 and those are still all rejected
+const float MIN_COVERAGE = 1. / (255. * 20.);
+
 float attenuation(float distance){
     return 1 + 0.007*distance + 0.00013*distance*distance;
 }
 
 void main()
 {
+    // taken before the first discard, the lookups after it are in non-uniform control flow
+    vec2 uv_dx = dFdx(uv_in);
+    vec2 uv_dy = dFdy(uv_in);
+
+    // Find strand point visibility, turbulence texture gives the fur strands.
+    // Most shell fragments fall between strands, so reject them before any texture or lighting work.
+    float tip_thinning = (1. - layer_dist*sqrt(layer_dist));
+    float strand = tip_thinning * materialTextureGrad(material, MATERIAL_TURBULENCE, uv_in, uv_dx, uv_dy).a;
+    if (strand < MIN_COVERAGE) discard;
+
     vec4 color;
     vec3 mat_diff = vec3(1.,1.,1.);
     vec3 mat_spec = vec3(1.,1.,1.);
 
     // get the texture color.
-    vec4 frag_color = texture(tex, uv_in);
-    float tip_thinning = (1. - layer_dist*sqrt(layer_dist));
-    // Find strand point visibility, turbulence texture gives the fur strands.
-    color.a = frag_color.a * tip_thinning * texture(turbulence, uv_in).a;
+    vec4 frag_color = materialTextureGrad(material, MATERIAL_COLOR, uv_in, uv_dx, uv_dy);
+    color.a = frag_color.a * strand;
+    if (color.a < MIN_COVERAGE) discard;
 
-    float roughness = texture(roughness_map, uv_in).x;
+    float roughness = materialTextureGrad(material, MATERIAL_ROUGHNESS, uv_in, uv_dx, uv_dy).x;
     float mat_shine = (5.f/(roughness*roughness));
 
     // find transform from tangent-space to world-space
@@ -58,7 +89,7 @@ void main()
     );
 
     // find world-space normal from normal map in tangent-space
-    normal = texture(normal_map, uv_in).xyz * 2 - 1;
+    normal = materialTextureGrad(material, MATERIAL_NORMAL, uv_in, uv_dx, uv_dy).xyz * 2 - 1;
     normal = normalize(normal);
     normal = TBN * normal;
 
@@ -105,14 +136,12 @@ void main()
     intensity.b = min(1., intensity.b);
     float root_darkening = (0.9 + 0.2*layer_dist*layer_dist);
     color.rgb = root_darkening * intensity * frag_color.rgb + reflective_intensity + dither(uv_in);
-    accumulation = color;
-
+#ifdef ALPHA_TO_COVERAGE
+    coverage_color = color;
+#else
     float weight = 4e3*pow(1-gl_FragCoord.z, 3.);
     weight = clamp(weight, 3e-4, 1.);
 
-    accumulation.rgb *= color.a;
-    accumulation *= weight;
-    revealage = color.a;
-    modulation.rgb = accumulation.a * (1 - frag_color.rgb);
-    modulation.a = color.a;
+    writeTransparency(color, frag_color.rgb, weight, modulation, accumulation, revealage);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,81 @@
+#version 430 core
+#ifdef BINDLESS_MATERIALS
+#extension GL_ARB_bindless_texture : require
+// one multi draw spans every material, so the handle is not dynamically uniform across the call.
+// ARB_bindless_texture alone leaves sampling through such a handle undefined, NV_gpu_shader5 allows it
+#extension GL_NV_gpu_shader5 : require
+#endif
+
+// Material lookups shared by the lit shaders, linked into their fragment and geometry stages, see MaterialTable.
+// With bindless textures a slot holds the texture handle. Without, the texture was copied into a layer of
+// one of the material arrays and the slot holds the array and the layer.
+// Single color maps skip the texture, their slot holds the color.
+
+#define MATERIAL_SLOTS 5
+// shifted left by the slot, the slot holds a packed color instead of a texture
+#define MATERIAL_FLAG_CONSTANT_SLOT 256u
+
+struct MaterialData {
+    uvec2 textures[MATERIAL_SLOTS];
+    uint flags;
+    float fur_length;
+};
+
+layout(std430, binding = 3) readonly buffer Materials {
+    MaterialData materials[];
+};
+
+#ifndef BINDLESS_MATERIALS
+layout(binding = 8) uniform sampler2DArray material_arrays[6];
+#endif
+
+vec4 materialTexture(uint material, int slot, vec2 uv) {
+    uvec2 texture_id = materials[material].textures[slot];
+    if ((materials[material].flags & (MATERIAL_FLAG_CONSTANT_SLOT << slot)) != 0u) {
+        return unpackUnorm4x8(texture_id.x);
+    }
+#ifdef BINDLESS_MATERIALS
+    return texture(sampler2D(texture_id), uv);
+#else
+    vec3 coord = vec3(uv, float(texture_id.y));
+    // not uniform across a multi draw, materials differ between its draws. A 2x2 quad never spans two
+    // draws though, so all of its fragments take the same case and the implicit derivatives stay valid
+    switch (texture_id.x) {
+        case 0u: return texture(material_arrays[0], coord);
+        case 1u: return texture(material_arrays[1], coord);
+        case 2u: return texture(material_arrays[2], coord);
+        case 3u: return texture(material_arrays[3], coord);
+        case 4u: return texture(material_arrays[4], coord);
+        default: return texture(material_arrays[5], coord);
+    }
+#endif
+}
+
+// the same with explicit uv derivatives, for lookups after a discard where implicit ones are undefined
+vec4 materialTextureGrad(uint material, int slot, vec2 uv, vec2 uv_dx, vec2 uv_dy) {
+    uvec2 texture_id = materials[material].textures[slot];
+    if ((materials[material].flags & (MATERIAL_FLAG_CONSTANT_SLOT << slot)) != 0u) {
+        return unpackUnorm4x8(texture_id.x);
+    }
+#ifdef BINDLESS_MATERIALS
+    return textureGrad(sampler2D(texture_id), uv, uv_dx, uv_dy);
+#else
+    vec3 coord = vec3(uv, float(texture_id.y));
+    switch (texture_id.x) {
+        case 0u: return textureGrad(material_arrays[0], coord, uv_dx, uv_dy);
+        case 1u: return textureGrad(material_arrays[1], coord, uv_dx, uv_dy);
+        case 2u: return textureGrad(material_arrays[2], coord, uv_dx, uv_dy);
+        case 3u: return textureGrad(material_arrays[3], coord, uv_dx, uv_dy);
+        case 4u: return textureGrad(material_arrays[4], coord, uv_dx, uv_dy);
+        default: return textureGrad(material_arrays[5], coord, uv_dx, uv_dy);
+    }
+#endif
+}
+
+uint materialFlags(uint material) {
+    return materials[material].flags;
+}
+
+float materialFurLength(uint material) {
+    return materials[material].fur_length;
+}
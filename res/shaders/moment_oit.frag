@@ -0,0 +1,107 @@
+#version 430 core
+
+// Transparency output shared by oit.frag, fur_shell.frag and fur_fin.frag, linked into their programs.
+// Weighted blended OIT needs a single pass. Moment based OIT (Muenstermann et al. 2018) first sums
+// the optical depth and four power moments of every transparent fragment's depth, then draws the
+// transparent geometry again and weights each fragment by the transmittance the moments give in front of it.
+
+#define TRANSPARENCY_WEIGHTED_BLENDED 0
+#define TRANSPARENCY_MOMENT_GENERATION 1
+#define TRANSPARENCY_MOMENT_RESOLVE 2
+
+uniform layout(location = 9) int transparency_mode;
+// log of the near and far plane, depth is warped logarithmically before taking moments
+uniform layout(location = 10) vec2 log_depth_range;
+
+layout(binding = 6) uniform sampler2D optical_depth_tex;
+layout(binding = 7) uniform sampler2D moments_tex;
+
+// bias towards a fixed distribution, keeps the reconstruction stable for 32 bit moments
+const float MOMENT_BIAS = 5e-7;
+const vec4 MOMENT_BIAS_VECTOR = vec4(0, 0.375, 0, 0.375);
+// how much a fragment is occluded by a surface at its own depth
+const float OVERESTIMATION = 0.25;
+
+float warpedDepth() {
+    float ndc = 2 * gl_FragCoord.z - 1;
+    float near = exp(log_depth_range.x);
+    float far = exp(log_depth_range.y);
+    float view_depth = 2 * near * far / (far + near - ndc * (far - near));
+    return (log(view_depth) - log_depth_range.x) / (log_depth_range.y - log_depth_range.x) * 2 - 1;
+}
+
+// fraction of the optical depth in front of depth, from a Cholesky factorization of the Hankel matrix
+float absorbanceInFront(vec4 b, float depth) {
+    b = mix(b, MOMENT_BIAS_VECTOR, MOMENT_BIAS);
+    vec3 z;
+    z[0] = depth;
+
+    float L21D11 = fma(-b[0], b[1], b[2]);
+    float D11 = fma(-b[0], b[0], b[1]);
+    float InvD11 = 1.0f / D11;
+    float L21 = L21D11 * InvD11;
+    float SquaredDepthVariance = fma(-b[1], b[1], b[3]);
+    float D22 = fma(-L21D11, L21, SquaredDepthVariance);
+
+    vec3 c = vec3(1.0f, z[0], z[0] * z[0]);
+    c[1] -= b.x;
+    c[2] -= b.y + L21 * c[1];
+    c[1] *= InvD11;
+    c[2] /= D22;
+    c[1] -= L21 * c[2];
+    c[0] -= dot(c.yz, b.xy);
+
+    // the roots of c[0] + c[1]*z + c[2]*z^2 are the other two support points
+    float InvC2 = 1.0f / c[2];
+    float p = c[1] * InvC2;
+    float q = c[0] * InvC2;
+    float D = (p * p * 0.25f) - q;
+    float r = sqrt(D);
+    z[1] = -p * 0.5f - r;
+    z[2] = -p * 0.5f + r;
+
+    vec3 weight_factor = vec3(OVERESTIMATION, (z[1] < z[0]) ? 1.0f : 0.0f, (z[2] < z[0]) ? 1.0f : 0.0f);
+    float f0 = weight_factor[0];
+    float f1 = weight_factor[1];
+    float f2 = weight_factor[2];
+    float f01 = (f1 - f0) / (z[1] - z[0]);
+    float f12 = (f2 - f1) / (z[2] - z[1]);
+    float f012 = (f12 - f01) / (z[2] - z[0]);
+    vec3 polynomial;
+    polynomial[0] = f012;
+    polynomial[1] = polynomial[0];
+    polynomial[0] = f01 - polynomial[0] * z[1];
+    polynomial[2] = polynomial[1];
+    polynomial[1] = polynomial[0] - polynomial[1] * z[0];
+    polynomial[0] = f0 - polynomial[0] * z[0];
+    return polynomial[0] + dot(b.xy, polynomial.yz);
+}
+
+void writeTransparency(vec4 color, vec3 base_color, float weight,
+                       out vec4 modulation, out vec4 accumulation, out float revealage) {
+    modulation = vec4(0);
+    accumulation = vec4(0);
+    revealage = 0;
+    if (transparency_mode == TRANSPARENCY_MOMENT_GENERATION) {
+        // optical depth goes to attachment 0, the moments weighted by it to attachment 1
+        float absorbance = -log(1 - min(color.a, 0.9999));
+        float depth = warpedDepth();
+        float depth_pow2 = depth * depth;
+        modulation.r = absorbance;
+        accumulation = vec4(depth, depth_pow2, depth_pow2 * depth, depth_pow2 * depth_pow2) * absorbance;
+    } else if (transparency_mode == TRANSPARENCY_MOMENT_RESOLVE) {
+        ivec2 coords = ivec2(gl_FragCoord.xy);
+        float optical_depth = texelFetch(optical_depth_tex, coords, 0).r;
+        if (optical_depth < 0.00100050033) discard;
+        vec4 b = texelFetch(moments_tex, coords, 0) / optical_depth;
+        float transmittance = clamp(exp(-optical_depth * absorbanceInFront(b, warpedDepth())), 0, 1);
+        accumulation = vec4(color.rgb * color.a, color.a) * transmittance;
+    } else {
+        accumulation = color;
+        accumulation.rgb *= color.a;
+        accumulation *= weight;
+        revealage = color.a;
+        modulation.rgb = accumulation.a * (1 - base_color);
+        modulation.a = color.a;
+    }
+}
@@ -10,20 +10,32 @@ in layout(location = 0) vec3 normal_in;
 in layout(location = 1) vec2 uv_in;
 in layout(location = 2) vec3 world_pos;
 in layout(location = 3) vec3 tangent_in;
+in layout(location = 6) flat uint material;
 
-uniform layout(location = 1) mat3 normal_matrix;
-uniform layout(location = 2) vec3 camera_pos;
-uniform PointLightSource point_light_sources[point_light_sources_len];
-uniform layout(location = 6) bool enable_nmap;
+// written once a frame, see FrameData in gamelogic.cpp
+layout(std140, binding = 0) uniform FrameData {
+    vec3 camera_pos;
+    vec3 wind;
+    PointLightSource point_light_sources[point_light_sources_len];
+};
+// slots and flags of MaterialData
+#define MATERIAL_COLOR 0
+#define MATERIAL_NORMAL 1
+#define MATERIAL_ROUGHNESS 2
+#define MATERIAL_FLAG_TEXTURED 1u
 
-layout(binding = 0) uniform sampler2D tex;
-layout(binding = 1) uniform sampler2D normal_map;
-layout(binding = 2) uniform sampler2D roughness_map;
+// material.glsl
+vec4 materialTexture(uint material, int slot, vec2 uv);
+uint materialFlags(uint material);
 
 layout (location = 0) out vec4 modulation;
 layout (location = 1) out vec4 accumulation;
 layout (location = 2) out float revealage;
 
+// moment_oit.frag, writes the outputs for the active transparency backend
+void writeTransparency(vec4 color, vec3 base_color, float weight,
+                       out vec4 modulation, out vec4 accumulation, out float revealage);
+
 float rand(vec2 co) { return fract(sin(dot(co.xy, vec2(12.9898,78.233))) * 43758.5453); }
 float dither(vec2 uv) { return (rand(uv)*2.0-1.0) / 256.0; }
 
@@ -48,13 +60,13 @@ void main()
     vec3 mat_spec = vec3(1.,1.,1.);
     vec4 frag_color = vec4(1.,1.,1., 1.);
     // get the texture color
-    frag_color = texture(tex, uv_in);
+    frag_color = materialTexture(material, MATERIAL_COLOR, uv_in);
     if (frag_color.a == 0) discard;
     // if this model uses normal maps
-    if (enable_nmap) {
+    if ((materialFlags(material) & MATERIAL_FLAG_TEXTURED) != 0u) {
 
         // get the roughness, how unshiny it is
-        float roughness = texture(roughness_map, uv_in).x;
+        float roughness = materialTexture(material, MATERIAL_ROUGHNESS, uv_in).x;
         mat_shine = (5.f/(roughness*roughness));
 
         // find transform from tangent-space to world-space
@@ -67,7 +79,7 @@ void main()
         );
 
         // find world-space normal from normal map in tangent-space
-        normal = texture(normal_map, uv_in).xyz * 2 - 1;
+        normal = materialTexture(material, MATERIAL_NORMAL, uv_in).xyz * 2 - 1;
         normal = normalize(normal);
         normal = TBN * normal;
     }
@@ -115,14 +127,9 @@ void main()
     intensity.b = min(1., intensity.b);
     color.a = frag_color.a;
     color.rgb = intensity * frag_color.rgb + reflective_intensity + dither(uv_in);
-    accumulation = color;
 
     float weight = 4e3*pow(1-gl_FragCoord.z, 2.8);
     weight = clamp(weight, 3e-3, 1.);
 
-    accumulation.rgb *= color.a;
-    accumulation *= weight;
-    revealage = color.a;
-    modulation.rgb = accumulation.a * (1 - frag_color.rgb);
-    modulation.a = color.a;
+    writeTransparency(color, frag_color.rgb, weight, modulation, accumulation, revealage);
 }
\ No newline at end of file
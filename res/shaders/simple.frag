@@ -10,15 +10,23 @@ in layout(location = 0) vec3 normal_in;
 in layout(location = 1) vec2 uv_in;
 in layout(location = 2) vec3 world_pos;
 in layout(location = 3) vec3 tangent_in;
+in layout(location = 6) flat uint material;
 
-uniform layout(location = 1) mat3 normal_matrix;
-uniform layout(location = 2) vec3 camera_pos;
-uniform PointLightSource point_light_sources[point_light_sources_len];
-uniform layout(location = 6) bool enable_nmap;
+// written once a frame, see FrameData in gamelogic.cpp
+layout(std140, binding = 0) uniform FrameData {
+    vec3 camera_pos;
+    vec3 wind;
+    PointLightSource point_light_sources[point_light_sources_len];
+};
+// slots and flags of MaterialData
+#define MATERIAL_COLOR 0
+#define MATERIAL_NORMAL 1
+#define MATERIAL_ROUGHNESS 2
+#define MATERIAL_FLAG_TEXTURED 1u
 
-layout(binding = 0) uniform sampler2D tex;
-layout(binding = 1) uniform sampler2D normal_map;
-layout(binding = 2) uniform sampler2D roughness_map;
+// material.glsl
+vec4 materialTexture(uint material, int slot, vec2 uv);
+uint materialFlags(uint material);
 
 layout(location = 0) out vec4 color;
 
@@ -39,12 +47,14 @@ void main()
     vec4 frag_color = vec4(1.,1.,1., 1.);
 
     // if this model uses textures
-    if (enable_nmap) {
+    if ((materialFlags(material) & MATERIAL_FLAG_TEXTURED) != 0u) {
         // get the texture color
-        frag_color = texture(tex, uv_in);
+        frag_color = materialTexture(material, MATERIAL_COLOR, uv_in);
+#ifdef ALPHA_TEST
         if (frag_color.a == 0) discard;
+#endif
         // get the roughness, how unshiny it is
-        float roughness = texture(roughness_map, uv_in).x;
+        float roughness = materialTexture(material, MATERIAL_ROUGHNESS, uv_in).x;
         mat_shine = (5.f/(roughness*roughness));
 
         // find transform from tangent-space to world-space
@@ -57,7 +67,7 @@ void main()
         );
 
         // find world-space normal from normal map in tangent-space
-        normal = texture(normal_map, uv_in).xyz * 2 - 1;
+        normal = materialTexture(material, MATERIAL_NORMAL, uv_in).xyz * 2 - 1;
         normal = normalize(normal);
         normal = TBN * normal;
     }
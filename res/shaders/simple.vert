@@ -5,22 +5,35 @@ in layout(location = 1) vec3 normal_in;
 in layout(location = 2) vec2 uv_in;
 in layout(location = 3) vec3 tangent_in;
 
-uniform layout(location = 1) mat3 normal_matrix;
-uniform layout(location = 3) mat4 MVP;
-uniform layout(location = 4) mat4 model;
+struct DrawData {
+    mat4 MVP;
+    mat4 model;
+    mat3 normal_matrix;
+    // surface, fur shell and fur fin material, see MaterialTable
+    uvec4 materials;
+    vec4 padding[4];
+};
+
+// bound at this draw's entry, see DrawDataBuffer
+layout(std430, binding = 0) readonly buffer DrawDataBuffer {
+    DrawData draws[];
+};
 
 out layout(location = 0) vec3 normal_out;
 out layout(location = 1) vec2 uv_out;
 out layout(location = 2) vec3 world_pos;
 out layout(location = 3) vec3 tangent_out;
+out layout(location = 6) flat uint material_out;
 
 void main()
 {
-    normal_out = normal_matrix * normal_in;
+    DrawData draw = draws[0];
+    normal_out = draw.normal_matrix * normal_in;
     normal_out = normalize(normal_out);
-    tangent_out = normal_matrix * tangent_in;
+    tangent_out = draw.normal_matrix * tangent_in;
     tangent_out = normalize(tangent_out);
     uv_out = uv_in;
-    gl_Position = MVP * vec4(position, 1.0f);
-    world_pos = (model * vec4(position, 1.0f)).xyz;
+    material_out = draw.materials.x;
+    gl_Position = draw.MVP * vec4(position, 1.0f);
+    world_pos = (draw.model * vec4(position, 1.0f)).xyz;
 }
@@ -0,0 +1,49 @@
+#version 430 core
+#ifdef HAS_DRAW_PARAMETERS
+#extension GL_ARB_shader_draw_parameters : require
+// the batch puts the draw's index in baseInstance, the whole buffer is bound
+#define DRAW_INDEX gl_BaseInstanceARB
+#else
+// one draw at a time, each with the buffer range bound at its entry
+#define DRAW_INDEX 0
+#endif
+
+in layout(location = 0) vec3 position;
+in layout(location = 1) vec3 normal_in;
+in layout(location = 2) vec2 uv_in;
+in layout(location = 3) vec3 tangent_in;
+
+struct DrawData {
+    mat4 MVP;
+    mat4 model;
+    mat3 normal_matrix;
+    // surface, fur shell and fur fin material, see MaterialTable
+    uvec4 materials;
+    vec4 padding[4];
+};
+
+layout(std430, binding = 0) readonly buffer DrawDataBuffer {
+    DrawData draws[];
+};
+
+out layout(location = 0) vec3 normal_out;
+out layout(location = 1) vec2 uv_out;
+out layout(location = 2) vec3 world_pos;
+out layout(location = 3) vec3 tangent_out;
+out layout(location = 6) flat uint material_out;
+
+// the depth pre-pass computes the same position, GL_EQUAL needs them bit identical
+invariant gl_Position;
+
+void main()
+{
+    DrawData draw = draws[DRAW_INDEX];
+    normal_out = draw.normal_matrix * normal_in;
+    normal_out = normalize(normal_out);
+    tangent_out = draw.normal_matrix * tangent_in;
+    tangent_out = normalize(tangent_out);
+    uv_out = uv_in;
+    material_out = draw.materials.x;
+    gl_Position = draw.MVP * vec4(position, 1.0f);
+    world_pos = (draw.model * vec4(position, 1.0f)).xyz;
+}
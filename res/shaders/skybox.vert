@@ -1,18 +1,17 @@
 #version 430 core
 
-in layout(location = 0) vec3 position;
-in layout(location = 1) vec3 normal_in;
-in layout(location = 2) vec2 uv_in;
-in layout(location = 3) vec3 tangent_in;
-
-uniform layout(location = 3) mat4 MVP;
+// inverse of the view projection without the camera translation
+uniform layout(location = 3) mat4 inverse_VP;
 
 out layout(location = 0) vec3 uv_out;
 
 
 void main()
 {
-    uv_out = -position;
-    gl_Position = MVP * vec4(position, 1.0f);
-    gl_Position = gl_Position.xyww;
+    // one triangle covering the screen, no vertex buffer
+    vec2 ndc = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0f - 1.0f;
+    vec4 direction = inverse_VP * vec4(ndc, 1.0f, 1.0f);
+    uv_out = -direction.xyz / direction.w;
+    // on the far plane, so GL_LEQUAL only passes where no geometry was drawn
+    gl_Position = vec4(ndc, 1.0f, 1.0f);
 }
@@ -0,0 +1,394 @@
+#include <glad/glad.h>
+#include "benchmark.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <vector>
+#include <fmt/format.h>
+
+#include "gamelogic.h"
+#include "utilities/camerapath.hpp"
+#include "utilities/drawstats.hpp"
+#include "utilities/gputimer.hpp"
+#include "utilities/framecapture.hpp"
+
+namespace {
+    struct FrameSample {
+        double cpu_ms = 0;
+        double frame_ms = 0;
+        uint64_t draw_calls = 0;
+        uint64_t draws = 0;
+        // from the frame's fence, a few frames later
+        bool has_pacing = false;
+        double wait_ms = 0;
+        double latency_ms = 0;
+        // filled in when the queries come back, a few frames later
+        bool has_primitives = false;
+        uint64_t primitives = 0;
+        std::map<std::string, double> gpu_ms;
+    };
+
+    struct Summary {
+        double avg = 0, p50 = 0, p95 = 0, p99 = 0, max = 0;
+        size_t count = 0;
+    };
+
+    Summary summarize(std::vector<double> values) {
+        Summary summary;
+        if (values.empty()) return summary;
+        std::sort(values.begin(), values.end());
+        double sum = 0;
+        for (double value : values) sum += value;
+        auto percentile = [&](double p) { return values[size_t(p * (values.size() - 1))]; };
+        summary.avg = sum / values.size();
+        summary.p50 = percentile(0.5);
+        summary.p95 = percentile(0.95);
+        summary.p99 = percentile(0.99);
+        summary.max = values.back();
+        summary.count = values.size();
+        return summary;
+    }
+
+    void printUsage() {
+        std::cerr << "usage: fur_project [--benchmark | --headless] [options]\n"
+                     "  --headless             surfaceless EGL context, no display needed\n"
+                     "  --capture <directory>  write the measured frames there\n"
+                     "  --capture-format <f>   png, raw or y4m, default png\n"
+                     "  --camera-path <file>   keyframes, one \"time x y z pitch yaw\" per line\n"
+                     "  --warmup <frames>      frames drawn before measuring, default 100\n"
+                     "  --frames <frames>      measured frames, default 500\n"
+                     "  --timestep <seconds>   simulated time per frame, default 1/60\n"
+                     "  --size <w>x<h>         render size, default 1600x900\n"
+                     "  --quality <level>      low, medium or high, default medium\n"
+                     "  --frames-in-flight <n> 1 to 3, how far the cpu may run ahead of the gpu, default 2\n"
+                     "  --threads <n>          threads for the scene update and culling, default every core\n"
+                     "  --texture-arrays       material textures from texture arrays instead of bindless handles\n"
+                     "  --no-streaming         load every texture in full at startup\n"
+                     "  --memory-budget <MiB>  gpu memory streaming keeps under, 0 for none, default by quality\n"
+                     "  --report <file>        .json or .csv, default benchmark.csv\n"
+                     "Set LIBGL_ALWAYS_SOFTWARE=1 to measure on Mesa llvmpipe." << std::endl;
+    }
+
+    bool endsWith(const std::string &text, const std::string &suffix) {
+        return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    // the stage columns, the frame total is reported on its own
+    std::vector<std::string> stagePaths() {
+        std::vector<std::string> stages;
+        for (const auto &path : gpu_profiler.paths()) {
+            if (path != "frame") stages.push_back(path);
+        }
+        return stages;
+    }
+
+    std::string stageName(const std::string &path) {
+        return path.rfind("frame/", 0) == 0 ? path.substr(6) : path;
+    }
+
+    void writeCsv(std::ostream &out, const std::vector<FrameSample> &frames) {
+        auto stages = stagePaths();
+        out << "frame,cpu_ms,frame_ms,gpu_ms,wait_ms,latency_ms,draw_calls,draws,primitives";
+        for (const auto &stage : stages) out << "," << stageName(stage) << "_ms";
+        out << "\n";
+        auto gpu = [](const FrameSample &frame, const std::string &path) {
+            auto found = frame.gpu_ms.find(path);
+            return found == frame.gpu_ms.end() ? std::string() : fmt::format("{:.4f}", found->second);
+        };
+        for (size_t i = 0; i < frames.size(); ++i) {
+            const auto &frame = frames[i];
+            out << fmt::format("{},{:.4f},{:.4f},{},{},{},{},{},{}", i, frame.cpu_ms, frame.frame_ms, gpu(frame, "frame"),
+                               frame.has_pacing ? fmt::format("{:.4f}", frame.wait_ms) : std::string(),
+                               frame.has_pacing ? fmt::format("{:.4f}", frame.latency_ms) : std::string(),
+                               frame.draw_calls, frame.draws,
+                               frame.has_primitives ? std::to_string(frame.primitives) : std::string());
+            for (const auto &stage : stages) out << "," << gpu(frame, stage);
+            out << "\n";
+        }
+    }
+
+    // a JSON string literal, quotes included
+    std::string jsonString(const std::string &text) {
+        std::string quoted = "\"";
+        for (unsigned char c : text) {
+            if (c == '"' || c == '\\') {
+                quoted += '\\';
+                quoted += char(c);
+            } else if (c < 0x20) {
+                quoted += fmt::format("\\u{:04x}", c);
+            } else {
+                quoted += char(c);
+            }
+        }
+        return quoted + "\"";
+    }
+
+    void writeJson(std::ostream &out, const BenchmarkOptions &options, const std::vector<FrameSample> &frames) {
+        std::map<std::string, std::vector<double>> metrics;
+        for (const auto &frame : frames) {
+            metrics["cpu_ms"].push_back(frame.cpu_ms);
+            metrics["frame_ms"].push_back(frame.frame_ms);
+            metrics["draw_calls"].push_back(double(frame.draw_calls));
+            metrics["draws"].push_back(double(frame.draws));
+            if (frame.has_primitives) metrics["primitives"].push_back(double(frame.primitives));
+            if (frame.has_pacing) {
+                metrics["wait_ms"].push_back(frame.wait_ms);
+                metrics["latency_ms"].push_back(frame.latency_ms);
+            }
+            for (const auto &entry : frame.gpu_ms) {
+                metrics[entry.first == "frame" ? "gpu_ms" : stageName(entry.first) + "_ms"].push_back(entry.second);
+            }
+        }
+
+        out << "{\n  \"settings\": {"
+            << fmt::format("\"camera_path\": {}, \"warmup_frames\": {}, \"measured_frames\": {}, "
+                           "\"timestep\": {}, \"width\": {}, \"height\": {}, \"frames_in_flight\": {}, \"job_threads\": {}, "
+                           "\"bindless_textures\": {}, \"texture_streaming\": {}, \"gpu_memory_budget_mb\": {}, "
+                           "\"gpu_memory_mb\": {:.1f}",
+                           jsonString(options.camera_path), options.warmup_frames, options.measured_frames,
+                           options.timestep, options.width, options.height, render_settings.frames_in_flight,
+                           render_settings.job_threads, material_table.bindless(), render_settings.texture_streaming,
+                           render_settings.gpu_memory_budget_mb, texture_residency.totalBytes() / (1024. * 1024.))
+            << "},\n  \"summary\": {";
+        bool first = true;
+        for (const auto &metric : metrics) {
+            Summary summary = summarize(metric.second);
+            out << (first ? "\n" : ",\n")
+                << fmt::format("    \"{}\": {{\"avg\": {:.4f}, \"p50\": {:.4f}, \"p95\": {:.4f}, \"p99\": {:.4f}, "
+                               "\"max\": {:.4f}, \"samples\": {}}}",
+                               metric.first, summary.avg, summary.p50, summary.p95, summary.p99, summary.max,
+                               summary.count);
+            first = false;
+        }
+        out << "\n  },\n  \"frames\": [";
+        for (size_t i = 0; i < frames.size(); ++i) {
+            const auto &frame = frames[i];
+            out << (i == 0 ? "\n" : ",\n")
+                << fmt::format("    {{\"cpu_ms\": {:.4f}, \"frame_ms\": {:.4f}, \"draw_calls\": {}, \"draws\": {}",
+                               frame.cpu_ms, frame.frame_ms, frame.draw_calls, frame.draws);
+            if (frame.has_primitives) out << ", \"primitives\": " << frame.primitives;
+            if (frame.has_pacing) {
+                out << fmt::format(", \"wait_ms\": {:.4f}, \"latency_ms\": {:.4f}", frame.wait_ms, frame.latency_ms);
+            }
+            for (const auto &entry : frame.gpu_ms) {
+                out << fmt::format(", \"{}\": {:.4f}",
+                                   entry.first == "frame" ? "gpu_ms" : stageName(entry.first) + "_ms", entry.second);
+            }
+            out << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+}
+
+bool parseBenchmarkArguments(int argc, char **argv, BenchmarkOptions &options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        std::string value = hasValue ? argv[i + 1] : "";
+        bool valid = true;
+        if (arg == "--benchmark") {
+            options.enabled = true;
+            continue;
+        } else if (arg == "--headless") {
+            options.enabled = true;
+            options.headless = true;
+            continue;
+        } else if (arg == "--texture-arrays") {
+            options.texture_arrays = true;
+            continue;
+        } else if (arg == "--no-streaming") {
+            options.no_streaming = true;
+            continue;
+        } else if (!hasValue) {
+            valid = false;
+        } else if (arg == "--camera-path") {
+            options.camera_path = value;
+        } else if (arg == "--report") {
+            options.report = value;
+        } else if (arg == "--warmup") {
+            options.warmup_frames = std::atoi(value.c_str());
+            valid = options.warmup_frames >= 0;
+        } else if (arg == "--frames") {
+            options.measured_frames = std::atoi(value.c_str());
+            valid = options.measured_frames > 0;
+        } else if (arg == "--timestep") {
+            options.timestep = std::atof(value.c_str());
+            valid = options.timestep > 0;
+        } else if (arg == "--size") {
+            valid = std::sscanf(value.c_str(), "%dx%d", &options.width, &options.height) == 2
+                    && options.width > 0 && options.height > 0;
+        } else if (arg == "--capture") {
+            options.enabled = true;
+            options.capture_directory = value;
+        } else if (arg == "--capture-format") {
+            if (value == "png") options.capture_format = CaptureFormat::PNG;
+            else if (value == "raw") options.capture_format = CaptureFormat::RAW;
+            else if (value == "y4m") options.capture_format = CaptureFormat::Y4M;
+            else valid = false;
+        } else if (arg == "--frames-in-flight") {
+            options.frames_in_flight = std::atoi(value.c_str());
+            valid = options.frames_in_flight >= 1 && options.frames_in_flight <= FramePacer::MAX_FRAMES_IN_FLIGHT;
+        } else if (arg == "--threads") {
+            options.job_threads = std::atoi(value.c_str());
+            valid = options.job_threads > 0;
+        } else if (arg == "--memory-budget") {
+            options.memory_budget_mb = std::atof(value.c_str());
+            valid = options.memory_budget_mb >= 0;
+        } else if (arg == "--quality") {
+            valid = parseQualityLevel(value, options.quality);
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            std::cerr << "Bad argument " << arg << (hasValue ? " " + value : "") << std::endl;
+            printUsage();
+            return false;
+        }
+        ++i;
+    }
+    return true;
+}
+
+bool run_benchmark(GLFWwindow* window, const BenchmarkOptions &options) {
+    using clock = std::chrono::steady_clock;
+    auto milliseconds = [](clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    };
+
+    CameraPath path;
+    if (!options.camera_path.empty() && !path.load(options.camera_path)) return false;
+    // headless contexts have no default framebuffer, the output always goes to the capture target
+    FrameCapture capture;
+    bool capturing = !options.capture_directory.empty();
+    int fps = std::max(1, int(std::lround(1. / options.timestep)));
+    if (capturing && !capture.open(options.capture_directory, options.capture_format, fps)) return false;
+    bool offscreenOutput = capturing || options.headless;
+
+    // the job system, the material table and the render targets are set up by initialize_game
+    applyQualityLevel(render_settings, options.quality);
+    if (options.memory_budget_mb >= 0) render_settings.gpu_memory_budget_mb = options.memory_budget_mb;
+    if (options.job_threads > 0) render_settings.job_threads = options.job_threads;
+    if (options.texture_arrays) render_settings.bindless_textures = false;
+    if (options.no_streaming) render_settings.texture_streaming = false;
+    initialize_game(window);
+    // the render size has to stay put for runs to be comparable
+    render_settings.dynamic_resolution = false;
+    render_settings.gpu_profiling = true;
+    render_settings.profile_report_seconds = std::numeric_limits<float>::infinity();
+    if (options.frames_in_flight > 0) render_settings.frames_in_flight = options.frames_in_flight;
+    setFixedTimestep(options.timestep);
+    if (!path.empty()) setCameraPath(&path);
+    // measure the renderer, not the display
+    render_settings.swap_interval = 0;
+    render_settings.frame_rate_limit = 0;
+    if (!options.headless) glfwSwapInterval(render_settings.swap_interval);
+
+    // a few extra frames at the end let the profiler read back the last measured ones
+    int total = options.warmup_frames + options.measured_frames + GpuProfiler::FRAME_LATENCY;
+    std::vector<FrameSample> frames(total);
+    GpuQueryRing primitives(GL_PRIMITIVES_GENERATED);
+    // like the profiler, the pacer numbers frames from the first updateFrame
+    int pacedFrames = 0;
+    auto collectGpu = [&]() {
+        GLuint64 count;
+        int index;
+        while (primitives.pollNext(count, index)) {
+            if (index >= total) continue;
+            frames[index].primitives = count;
+            frames[index].has_primitives = true;
+        }
+        int latest = gpu_profiler.latestFrame();
+        if (latest >= 0 && latest < total) frames[latest].gpu_ms = gpu_profiler.latestTimes();
+        for (; pacedFrames <= frame_pacer.latestFrame() && pacedFrames < total; ++pacedFrames) {
+            FramePacer::Timings timings;
+            if (!frame_pacer.timings(pacedFrames, timings)) continue;
+            frames[pacedFrames].has_pacing = true;
+            frames[pacedFrames].wait_ms = timings.wait_ms;
+            frames[pacedFrames].latency_ms = timings.latency_ms;
+        }
+    };
+
+    std::cout << fmt::format("Benchmark: {} warm-up and {} measured frames at {}x{}",
+                             options.warmup_frames, options.measured_frames, options.width, options.height) << std::endl;
+    for (int i = 0; i < total; ++i) {
+        auto start = clock::now();
+        glfwPollEvents();
+        draw_stats.reset();
+        updateFrame(window);
+        if (offscreenOutput) {
+            int width, height;
+            glfwGetFramebufferSize(window, &width, &height);
+            capture.resize(width, height);
+            setOutputFramebuffer(capture.framebuffer());
+        }
+        primitives.begin();
+        renderFrame(window);
+        primitives.end();
+        bool measuredFrame = i >= options.warmup_frames && i < options.warmup_frames + options.measured_frames;
+        if (capturing && measuredFrame) capture.capture(capture.framebuffer());
+        auto submitted = clock::now();
+        if (!options.headless) glfwSwapBuffers(window);
+
+        FrameSample &frame = frames[i];
+        frame.cpu_ms = milliseconds(submitted - start);
+        frame.frame_ms = milliseconds(clock::now() - start);
+        frame.draw_calls = draw_stats.draw_calls;
+        frame.draws = draw_stats.draws;
+        collectGpu();
+    }
+    glFinish();
+    frame_pacer.collect(true);
+    collectGpu();
+    capture.finish();
+    setOutputFramebuffer(0);
+    setCameraPath(nullptr);
+    setFixedTimestep(0);
+    if (capturing) {
+        std::cout << "Captured " << capture.framesWritten() << " frames to " << options.capture_directory
+                  << ", " << capture.stalls() << " waited on the gpu or the encoders" << std::endl;
+    }
+
+    std::vector<FrameSample> measured(frames.begin() + options.warmup_frames,
+                                      frames.begin() + options.warmup_frames + options.measured_frames);
+    std::ofstream report(options.report);
+    if (!report) {
+        std::cerr << "Could not write benchmark report " << options.report << std::endl;
+        return false;
+    }
+    if (endsWith(options.report, ".json")) {
+        writeJson(report, options, measured);
+    } else {
+        writeCsv(report, measured);
+    }
+
+    std::vector<double> cpu, gpu, latency, wait;
+    for (const auto &frame : measured) {
+        cpu.push_back(frame.cpu_ms);
+        if (frame.has_pacing) {
+            latency.push_back(frame.latency_ms);
+            wait.push_back(frame.wait_ms);
+        }
+        auto found = frame.gpu_ms.find("frame");
+        if (found != frame.gpu_ms.end()) gpu.push_back(found->second);
+    }
+    Summary cpuSummary = summarize(cpu);
+    Summary gpuSummary = summarize(gpu);
+    Summary latencySummary = summarize(latency);
+    Summary waitSummary = summarize(wait);
+    std::cout << fmt::format("cpu avg {:.3f} ms  p95 {:.3f}  p99 {:.3f}", cpuSummary.avg, cpuSummary.p95, cpuSummary.p99)
+              << std::endl
+              << fmt::format("latency avg {:.3f} ms  p95 {:.3f}, fence wait avg {:.3f} ms",
+                             latencySummary.avg, latencySummary.p95, waitSummary.avg)
+              << std::endl
+              << fmt::format("gpu avg {:.3f} ms  p95 {:.3f}  p99 {:.3f}", gpuSummary.avg, gpuSummary.p95, gpuSummary.p99)
+              << std::endl
+              << "Wrote " << options.report << std::endl;
+    return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+#include <string>
+
+#include "render_settings.hpp"
+#include "utilities/framecapture.hpp"
+#include "window.hpp"
+
+// A repeatable run: fixed timestep, scripted camera, warm-up frames that are thrown away, then measured frames
+struct BenchmarkOptions {
+    bool enabled = false;
+    // keyframes for the camera, the scene's start position if empty
+    std::string camera_path;
+    // .json for a summary with every frame, anything else is csv with one row per frame
+    std::string report = "benchmark.csv";
+    int warmup_frames = 100;
+    int measured_frames = 500;
+    double timestep = 1. / 60.;
+    int width = DEFAULT_WINDOW_WIDTH;
+    int height = DEFAULT_WINDOW_HEIGHT;
+    QualityLevel quality = QualityLevel::MEDIUM;
+    // how far the cpu may run ahead of the gpu, the render settings' default if 0
+    int frames_in_flight = 0;
+    // threads for the scene work, the render settings' default if 0
+    int job_threads = 0;
+    // copy material textures into texture arrays even where bindless textures are supported
+    bool texture_arrays = false;
+    // load every texture in full instead of streaming material maps
+    bool no_streaming = false;
+    // MiB textures, targets and buffers are kept under, the quality level's if negative, 0 for no limit
+    float memory_budget_mb = -1;
+    // surfaceless EGL context, no display server needed
+    bool headless = false;
+    // write the measured frames here if set
+    std::string capture_directory;
+    CaptureFormat capture_format = CaptureFormat::PNG;
+};
+
+// reads --benchmark, --headless or --capture and their options,
+// prints usage and returns false on anything it doesn't know
+bool parseBenchmarkArguments(int argc, char **argv, BenchmarkOptions &options);
+// runs the frames and writes the report, false if the camera path or report can't be used
+bool run_benchmark(GLFWwindow* window, const BenchmarkOptions &options);
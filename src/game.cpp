@@ -1,6 +1,44 @@
 #include <GLFW/glfw3.h>
 #include <glad/glad.h>
+#include <iostream>
+#include <memory>
 #include "gamelogic.h"
+#include "render_settings.hpp"
+#include "utilities/cpuprofiler.hpp"
+#include "utilities/framecapture.hpp"
+
+const char *cpu_trace_filename = "cpu_trace.json";
+
+// F10 records the window to recordings/<n>/frames_<w>x<h>.y4m, a fresh capture per recording
+std::unique_ptr<FrameCapture> recorder;
+int recording_count = 0;
+
+void toggleRecording() {
+    if (recorder) {
+        recorder->finish();
+        std::cout << "Recorded " << recorder->framesWritten() << " frames, "
+                  << recorder->stalls() << " waited on the gpu or the encoders" << std::endl;
+        recorder.reset();
+        return;
+    }
+    std::string directory = "recordings/" + std::to_string(recording_count++);
+    recorder = std::make_unique<FrameCapture>();
+    if (recorder->open(directory, CaptureFormat::Y4M)) {
+        std::cout << "Recording to " << directory << std::endl;
+    } else {
+        recorder.reset();
+    }
+}
+
+void dumpCpuTrace() {
+#ifdef FUR_CPU_PROFILING
+    if (CpuProfiler::writeChromeTrace(cpu_trace_filename)) {
+        std::cout << "Wrote cpu trace to " << cpu_trace_filename << std::endl;
+    } else {
+        std::cerr << "Could not write cpu trace to " << cpu_trace_filename << std::endl;
+    }
+#endif
+}
 
 
 void handle_poll_events(GLFWwindow *window){
@@ -14,24 +52,56 @@ void handleKeyboardInput(GLFWwindow* window)
     {
         glfwSetWindowShouldClose(window, GL_TRUE);
     }
+
+    // F9 writes the recorded cpu zones, once per press
+    static bool dumpHeld = false;
+    bool dumpPressed = glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS;
+    if (dumpPressed && !dumpHeld) dumpCpuTrace();
+    dumpHeld = dumpPressed;
+
+    static bool recordHeld = false;
+    bool recordPressed = glfwGetKey(window, GLFW_KEY_F10) == GLFW_PRESS;
+    if (recordPressed && !recordHeld) toggleRecording();
+    recordHeld = recordPressed;
 }
 
 void run_game(GLFWwindow* window){
 
     initialize_game(window);
+    if (render_settings.hot_reload) startHotReload(window);
+    int swap_interval = render_settings.swap_interval;
+    glfwSwapInterval(swap_interval);
 
     // Rendering Loop
     while (!glfwWindowShouldClose(window))
     {
+        if (render_settings.swap_interval != swap_interval) {
+            swap_interval = render_settings.swap_interval;
+            glfwSwapInterval(swap_interval);
+        }
 
         glfwPollEvents();
         handle_poll_events(window);
 
         updateFrame(window);
         renderFrame(window);
+        if (recorder) {
+            int width, height;
+            glfwGetFramebufferSize(window, &width, &height);
+            recorder->resize(width, height);
+            recorder->capture(0);
+        }
 
         handleKeyboardInput(window);
         // Flip buffers
-        glfwSwapBuffers(window);
+        {
+            PROFILE_ZONE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
+        frame_pacer.limit(render_settings.frame_rate_limit);
     }
+    // still needs the context to read back the last frames
+    if (recorder) toggleRecording();
+    stopHotReload();
+    dumpCpuTrace();
 }
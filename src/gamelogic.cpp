@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <GLFW/glfw3.h>
 #include <glad/glad.h>
 #include <iostream>
@@ -8,18 +10,40 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/transform.hpp>
 
-#include "utilities/imageLoader.hpp"
 #include "utilities/glfont.hpp"
 #include "utilities/timeutils.h"
 #include "utilities/shapes.hpp"
 #include "utilities/glutils.hpp"
 #include "utilities/shader.hpp"
+#include "utilities/drawbatch.hpp"
+#include "utilities/bvh.hpp"
+#include "utilities/hizculler.hpp"
+#include "utilities/rendertargets.hpp"
+#include "utilities/gputimer.hpp"
+#include "utilities/dynamicresolution.hpp"
+#include "utilities/gpuprofiler.hpp"
+#include "utilities/cpuprofiler.hpp"
+#include "utilities/drawstats.hpp"
+#include "utilities/camerapath.hpp"
+#include "utilities/framepacer.hpp"
+#include "utilities/jobsystem.hpp"
+#include "utilities/resourcecache.hpp"
+#include "utilities/residency.hpp"
+#include "utilities/hotreload.hpp"
 
 #include "gamelogic.h"
 #include "shader_uniform_defines.hpp"
 #include "window.hpp"
 #include "scenegraph.hpp"
+#include "render_settings.hpp"
 
+const QualityLevel default_quality = QualityLevel::MEDIUM;
+// starts out at the default preset, whatever callers change before initialize_game is kept
+RenderSettings render_settings = [] {
+    RenderSettings settings;
+    applyQualityLevel(settings, default_quality);
+    return settings;
+}();
 
 double padPositionX = 0;
 double padPositionZ = 0;
@@ -35,40 +59,122 @@ PointLight* topLeftLightNode;
 PointLight* topRightLightNode;
 PointLight* sunNode; // todo dirlight
 FlatGeometry* textNode;
+const float text_width = 400;
 
 CompositorNode *compositeNode;
 GLuint semitransparent_pass_fb;
-GLuint oit_color_buffer;
-GLuint oit_accum_tex;
-GLuint oit_reveal_tex;
-GLuint oit_depth_buffer;
+RenderTargetManager render_targets;
+RenderTargetID oit_color_target;
+RenderTargetID oit_accum_target;
+RenderTargetID oit_reveal_target;
+RenderTargetID oit_depth_target;
+// single sample copies of the scene, only rendered to with msaa
+GLuint resolve_fb;
+RenderTargetID resolved_color_target;
+RenderTargetID resolved_depth_target;
+std::vector<FurredGeometry*> coverage_shells;
+
+// Where the SEMITRANSPARENT pass rendered this frame, the oit targets unless it ran at a lower resolution
+struct TransparentTargets {
+    GLuint accum = 0;
+    GLuint reveal = 0;
+    GLuint modulation = 0;
+    GLuint depth = 0;
+    bool lowres = false;
+    // reveal holds the optical depth and accum the transmittance weighted color
+    GLuint moments = 0;
+    bool moment_based = false;
+};
+TransparentTargets transparent_targets;
+GLuint lowres_transparent_fb;
+GLuint moment_fb;
+
+const float near_plane = 0.1f;
+const float far_plane = 4000.f;
+
+GpuTimer frame_timer;
+GpuProfiler gpu_profiler;
+double last_profile_report = 0;
+DynamicResolution dynamic_resolution;
+
+// pooled opaque draws, collected from the culled geometry and submitted together
+DrawBatch opaque_batch;
+// matrices of every Geometry in the graph, indexed by drawID and written once a frame
+DrawDataBuffer draw_data;
+std::vector<Geometry*> drawn_geometry;
+// textures of every material, looked up by index from the DrawData
+MaterialTable material_table;
+ResidencyManager texture_residency;
+// what streamed material maps are loaded at before anything has been drawn
+const GLsizei initial_streamed_size = 256;
+// pixels an object one unit across spans at a depth of one unit
+float projected_scale = 1;
+HotReloader hot_reloader;
+// hidden window whose context shares objects with the main one, for rebuilding shaders off the render thread
+GLFWwindow* hot_reload_context = nullptr;
+
+// every pooled Geometry is an item in the BVH, indexed by its cullingID
+BVH scene_bvh;
+std::vector<Geometry*> culled_geometry;
+
+// transform updates, culling and opaque draw packets are split across these, GL calls stay on the main thread
+JobSystem* scene_jobs;
+// smaller subtrees are updated by whoever reaches them, a job costs more than a few matrix products
+const int parallel_subtree_size = 64;
+// geometry per draw packet job
+const size_t draw_packet_grain = 64;
+
+// gpu occlusion test of the pooled geometry against last frame's depth
+HiZCuller hiz_culler;
+glm::mat4 previous_VP;
+bool has_previous_depth = false;
+bool occlusion_commands_ready = false;
+
+// fins are a little longer than the shells to stick out of the fur volume
+const float fin_strand_length_fac = 1.2;
 
 // These are heap allocated, because they should not be initialised at the start of the program
 Gloom::Shader* opaque_lighting_shader;
+Gloom::Shader* opaque_batched_shader;
+Gloom::Shader* opaque_alphatest_shader;
+Gloom::Shader* depth_prepass_shader;
 Gloom::Shader* blending_lighting_shader;
 Gloom::Shader* flat_geometry_shader;
 Gloom::Shader* fur_shell_shader;
 Gloom::Shader* fur_fin_shader;
+Gloom::Shader* fur_shell_coverage_shader;
+Gloom::Shader* msaa_resolve_shader;
 Gloom::Shader* skybox_shader;
 Gloom::Shader* compositing_shader;
+Gloom::Shader* upsampling_compositing_shader;
+Gloom::Shader* moment_compositing_shader;
 
-const glm::vec3 boxDimensions(1, 1, 1);
 const glm::vec3 padDimensions(30, 3, 40);
 
 // global so it can be multiplied in to make MVP locally
 glm::mat4 VP;
 
-GLint uniform_light_sources_position_loc[UNIFORM_POINT_LIGHT_SOURCES_LEN];
-GLint uniform_light_sources_color_loc[UNIFORM_POINT_LIGHT_SOURCES_LEN];
-
-GLint uniform_oit_light_sources_position_loc[UNIFORM_POINT_LIGHT_SOURCES_LEN];
-GLint uniform_oit_light_sources_color_loc[UNIFORM_POINT_LIGHT_SOURCES_LEN];
-
-GLint fur_shell_uniform_light_sources_position_loc[UNIFORM_POINT_LIGHT_SOURCES_LEN];
-GLint fur_shell_uniform_light_sources_color_loc[UNIFORM_POINT_LIGHT_SOURCES_LEN];
-
-GLint fur_fin_uniform_light_sources_position_loc[UNIFORM_POINT_LIGHT_SOURCES_LEN];
-GLint fur_fin_uniform_light_sources_color_loc[UNIFORM_POINT_LIGHT_SOURCES_LEN];
+// Everything the shaders read once per frame, std140 like the FrameData block they declare.
+// Filled in during updateFrame and copied into this frame's slot of frame_data_ring when the gpu is done with it.
+struct PointLightSource {
+    glm::vec3 position;
+    float padding0;
+    glm::vec3 color;
+    float padding1;
+};
+struct FrameData {
+    glm::vec3 camera_pos;
+    float padding0;
+    glm::vec3 wind;
+    float padding1;
+    PointLightSource point_light_sources[UNIFORM_POINT_LIGHT_SOURCES_LEN];
+};
+static_assert(sizeof(FrameData) == 160, "FrameData has to match the std140 layout of the shaders");
+FrameData frame_data;
+
+FramePacer frame_pacer;
+FrameRing frame_data_ring;
+double last_pacing_report = 0;
 
 const float debug_startTime = 0;
 double realTime = debug_startTime;
@@ -78,50 +184,264 @@ glm::vec3 cameraRotation = glm::vec3(0, 0, 0);
 
 glm::vec3 wind = glm::vec3(0,0,0);
 
-GLuint create_cubemap(const std::string &foldername) {
-    GLuint tex_id = 0;
-    glGenTextures(1, &tex_id);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, tex_id);
-    std::string s[6] = {"posx.png", "negx.png", "negy.png", "posy.png", "posz.png", "negz.png"};
-    for (int i = 0; i < 6; ++i) {
-        auto tex = loadPNGFile(foldername + s[i]);
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, tex.width, tex.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, tex.pixels.data());
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+// set by the benchmark, a fixed step makes runs repeatable and a path replaces keyboard control
+double fixed_timestep = 0;
+const CameraPath *camera_path = nullptr;
+// where renderFrame puts the finished frame, offscreen for captures and headless runs
+GLuint output_framebuffer = 0;
 
-    return tex_id;
+TexturedGeometry::TexturedGeometry(const std::string &objname) : Geometry(objname) {
+    loadTextures(objname);
 }
 
-GLuint create_texture(const std::string &filename) {
-    auto tex = loadPNGFile(filename);
-    GLuint tex_id = 0;
-    glGenTextures(1, &tex_id);
-    glBindTexture(GL_TEXTURE_2D, tex_id);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex.width, tex.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, tex.pixels.data());
-    glGenerateMipmap(GL_TEXTURE_2D);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    return tex_id;
+// Material maps are streamed unless that is turned off, see ResidencyManager
+TextureHandle load_material_texture(const std::string &filename) {
+    if (!render_settings.texture_streaming) return resource_cache.texture(filename);
+    return resource_cache.streamedTexture(filename, initial_streamed_size);
 }
 
-TexturedGeometry::TexturedGeometry(const std::string &objname) : Geometry(objname) {
-    std::string filebase = "../res/textures/" + objname;
-    textureID = create_texture(filebase + "_col.png");
-    normalMapID = create_texture(filebase + "_nrm.png");
-    roughnessID = create_texture(filebase + "_rgh.png");
+void TexturedGeometry::loadTextures(const std::string &name) {
+    std::string filebase = "../res/textures/" + name;
+    colorMap = load_material_texture(filebase + "_col.png");
+    normalMap = load_material_texture(filebase + "_nrm.png");
+    roughnessMap = load_material_texture(filebase + "_rgh.png");
 }
 
 FurredGeometry::FurredGeometry(const std::string &objname) : TexturedGeometry(objname) {
     std::string filebase = "../res/textures/" + objname;
-    furID = create_texture(filebase + "_fur.png");
-    furNormalMapID = create_texture(filebase + "_fur_nrm.png");
-    strandTextureID = create_texture(filebase + "_fur_str.png");
-    furTurbulenceID = create_texture(filebase + "_fur_tur.png");
+    furMap = load_material_texture(filebase + "_fur.png");
+    furNormalMap = load_material_texture(filebase + "_fur_nrm.png");
+    strandMap = load_material_texture(filebase + "_fur_str.png");
+    furTurbulenceMap = load_material_texture(filebase + "_fur_tur.png");
+}
+// Registers every pooled Geometry below node with the scene BVH, gives every Geometry its draw data entry
+// and materials, and counts the subtree sizes
+void registerCulling(SceneNode* node) {
+    auto geometry = dynamic_cast<Geometry*>(node);
+    if (geometry && geometry->pooled) {
+        geometry->cullingID = scene_bvh.insert(AABB());
+        culled_geometry.push_back(geometry);
+    }
+    if (geometry) {
+        geometry->drawID = int(drawn_geometry.size());
+        drawn_geometry.push_back(geometry);
+        geometry->registerMaterials(material_table);
+    }
+    node->subtreeSize = 1;
+    for (SceneNode* child : node->children) {
+        registerCulling(child);
+        node->subtreeSize += child->subtreeSize;
+    }
+}
+
+// Frustum tests the BVH against VP and flags the Geometry that may be seen
+void cullScene() {
+    PROFILE_FUNCTION();
+    scene_jobs->parallelFor(culled_geometry.size(), draw_packet_grain, [](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) culled_geometry[i]->visible = false;
+    });
+    Frustum frustum = extractFrustum(VP);
+    scene_bvh.query(frustum, [&](int item) {
+        Geometry* geometry = culled_geometry[item];
+        geometry->visible = intersects(frustum, geometry->worldSphere);
+        if (!geometry->visible) return;
+        // w is the view depth, closer than the radius the camera is about inside it
+        const BoundingSphere &sphere = geometry->worldSphere;
+        float depth = (VP * glm::vec4(sphere.center, 1)).w;
+        geometry->screenSize = 2 * sphere.radius * projected_scale / std::max(depth, sphere.radius);
+    }, *scene_jobs);
+}
+
+// Asks for the material textures of everything visible at the size it is drawn, the residency manager
+// grows and shrinks them. A texture that changes gets a new id, so the materials are registered again.
+void updateTextureResidency() {
+    PROFILE_FUNCTION();
+    texture_residency.beginFrame();
+    for (auto geometry : culled_geometry) {
+        if (!geometry->visible) continue;
+        float texels = geometry->screenSize * render_settings.texture_detail;
+        for (GLuint material : geometry->materials) {
+            for (GLuint texture : material_table.material(material).textures) texture_residency.request(texture, texels);
+        }
+    }
+    texture_residency.track("render targets", render_targets.bytes());
+    texture_residency.track("mesh pool", mesh_pool.capacityBytes());
+    texture_residency.track("materials", material_table.bytes());
+    texture_residency.track("frame buffers", frame_data_ring.bytes() + draw_data.bytes() + opaque_batch.bytes());
+    GLsizeiptr budget = GLsizeiptr(render_settings.gpu_memory_budget_mb * 1024 * 1024);
+    if (texture_residency.update(budget)) registerSceneMaterials();
+}
+
+// after textures got new ids, the table still points at the old ones
+void registerSceneMaterials() {
+    // handles that go away have to stay resident until the frames using them are done
+    if (material_table.bindless()) frame_pacer.collect(true);
+    material_table.clear();
+    for (auto geometry : drawn_geometry) geometry->registerMaterials(material_table);
+    material_table.upload(material_table.bindless());
+    material_table.bind();
+}
+
+// Writes the draw data of everything that may be drawn this frame and fills opaque_batch with every visible
+// pooled opaque Geometry, in traversal order. Both run on the job system, the OPAQUE traversal then only
+// issues the unpooled draws.
+void buildDrawPackets() {
+    PROFILE_FUNCTION();
+    draw_data.beginFrame(frame_pacer.slot(), drawn_geometry.size());
+    scene_jobs->parallelFor(drawn_geometry.size(), draw_packet_grain, [](size_t begin, size_t end) {
+        PROFILE_ZONE("draw data");
+        for (size_t i = begin; i < end; ++i) {
+            Geometry* geometry = drawn_geometry[i];
+            if (!geometry->visible) continue;
+            DrawData data = makeDrawData(VP * geometry->modelTF, geometry->modelTF);
+            std::copy(std::begin(geometry->materials), std::end(geometry->materials), data.materials);
+            draw_data.set(i, data);
+        }
+    });
+
+    std::vector<Geometry*> opaque;
+    for (auto geometry : culled_geometry) {
+        // FurredGeometry hides render_pass with its own, the base mesh still goes through the opaque batch
+        if (geometry->visible && geometry->SceneNode::render_pass == OPAQUE) opaque.push_back(geometry);
+    }
+    opaque_batch.resize(opaque.size());
+    scene_jobs->parallelFor(opaque.size(), draw_packet_grain, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            Geometry* geometry = opaque[i];
+            opaque_batch.set(i, geometry->meshRange, geometry->drawID, geometry->batchMaterial());
+        }
+    });
+}
+
+bool multisampled() {
+    return render_targets.samples(oit_depth_target) > 1;
+}
+
+// The depth texture sampled after the opaque pass, the resolved copy when the oit targets are multisampled
+GLuint scene_depth_texture() {
+    return render_targets.texture(multisampled() ? resolved_depth_target : oit_depth_target);
+}
+
+// Runs the gpu occlusion test for every culled Geometry, drawMesh then draws through the resulting commands.
+// The depth texture still holds the previous frame, so the bounds are projected with that frame's VP.
+void occlusionCull() {
+    PROFILE_FUNCTION();
+    occlusion_commands_ready = false;
+    if (!render_settings.occlusion_culling || culled_geometry.empty()) return;
+
+    if (has_previous_depth) hiz_culler.buildPyramid(scene_depth_texture());
+    std::vector<CullObject> objects(culled_geometry.size());
+    scene_jobs->parallelFor(objects.size(), draw_packet_grain, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            Geometry* geometry = culled_geometry[i];
+            objects[i] = makeCullObject(geometry->meshRange, geometry->worldBounds, geometry->visible);
+        }
+    });
+    hiz_culler.cull(objects, previous_VP, has_previous_depth);
+    occlusion_commands_ready = true;
+}
+
+void Geometry::drawMesh() {
+    if (pooled && cullingID >= 0 && occlusion_commands_ready) {
+        // instanceCount was zeroed by the occlusion test if this is hidden
+        mesh_pool.bind();
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, hiz_culler.commandBuffer());
+        glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                               (void*)(cullingID * sizeof(DrawElementsIndirectCommand)));
+        draw_stats.count();
+    } else if (pooled) {
+        mesh_pool.bind();
+        mesh_pool.draw(meshRange);
+    } else {
+        glBindVertexArray(vaoID);
+        glDrawElements(GL_TRIANGLES, vaoIndicesSize, GL_UNSIGNED_INT, nullptr);
+        draw_stats.count();
+    }
+}
+
+// Reattaches the targets after the render size changed and resizes what depends on it
+void attach_render_targets() {
+    int width = render_targets.width();
+    int height = render_targets.height();
+
+    glNamedFramebufferTexture(semitransparent_pass_fb, GL_COLOR_ATTACHMENT0, render_targets.texture(oit_color_target), 0);
+    glNamedFramebufferTexture(semitransparent_pass_fb, GL_COLOR_ATTACHMENT1, render_targets.texture(oit_accum_target), 0);
+    glNamedFramebufferTexture(semitransparent_pass_fb, GL_COLOR_ATTACHMENT2, render_targets.texture(oit_reveal_target), 0);
+    glNamedFramebufferTexture(semitransparent_pass_fb, GL_DEPTH_ATTACHMENT, render_targets.texture(oit_depth_target), 0);
+    if (glCheckNamedFramebufferStatus(semitransparent_pass_fb, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << fmt::format("Framebuffer incomplete at {}x{}", width, height) << std::endl;
+    }
+    glNamedFramebufferTexture(resolve_fb, GL_COLOR_ATTACHMENT0, render_targets.texture(resolved_color_target), 0);
+    glNamedFramebufferTexture(resolve_fb, GL_DEPTH_ATTACHMENT, render_targets.texture(resolved_depth_target), 0);
+
+    hiz_culler.resize(width, height);
+    // the old depth is gone, the next frame only frustum culls
+    has_previous_depth = false;
+}
+
+// centers the text on the framebuffer the UI is drawn to
+void place_ui() {
+    if (!textNode) return;
+    textNode->position = { render_targets.outputWidth()/2 - text_width/2, render_targets.outputHeight()/2, 0};
+}
+
+// Called for the first frame and on every resize
+void resize_render_targets(int width, int height) {
+    if (render_targets.resize(width, height)) attach_render_targets();
+    place_ui();
+}
+
+struct OitFormatSet {
+    GLenum color;
+    GLenum accumulation;
+    GLenum revealage;
+};
+
+OitFormatSet oitFormats(OitFormats formats) {
+    switch (formats) {
+        case OitFormats::PRECISE: return {GL_RGBA32F, GL_RGBA16F, GL_R16F};
+        case OitFormats::BALANCED: return {GL_RGBA16F, GL_RGBA16F, GL_R16F};
+        case OitFormats::COMPACT: return {GL_R11F_G11F_B10F, GL_RGBA16F, GL_R8};
+    }
+    return {GL_RGBA32F, GL_RGBA16F, GL_R16F};
 }
+
+// Switches the oit targets to the configured formats and sample count.
+// The fur pass blends into all of them so they set its bandwidth.
+// Accumulation stays RGBA16F in every profile, its weighted sums leave the 0-1 range and need the alpha channel.
+void apply_oit_formats() {
+    OitFormatSet formats = oitFormats(render_settings.oit_formats);
+    bool changed = render_targets.setFormat(oit_color_target, formats.color);
+    changed |= render_targets.setFormat(oit_accum_target, formats.accumulation);
+    changed |= render_targets.setFormat(oit_reveal_target, formats.revealage);
+    changed |= render_targets.setFormat(resolved_color_target, formats.color);
+
+    int samples = std::max(1, render_settings.msaa_samples);
+    for (RenderTargetID target : {oit_color_target, oit_accum_target, oit_reveal_target, oit_depth_target}) {
+        changed |= render_targets.setSamples(target, samples);
+    }
+    if (changed) attach_render_targets();
+}
+
+void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
+    resize_render_targets(width, height);
+}
+
+// Moves the render scale toward the frame time budget, from timings a few frames old
+void updateResolutionScale() {
+    double gpuMilliseconds;
+    if (!frame_timer.poll(gpuMilliseconds)) return;
+    if (!render_settings.dynamic_resolution) {
+        if (render_targets.setScale(1.0f)) attach_render_targets();
+        return;
+    }
+    dynamic_resolution.configure(render_settings.target_frame_ms,
+                                 render_settings.min_resolution_scale, render_settings.max_resolution_scale);
+    if (dynamic_resolution.update(gpuMilliseconds) && render_targets.setScale(dynamic_resolution.scale())) {
+        attach_render_targets();
+    }
+}
+
 void GLAPIENTRY
 MessageCallback( GLenum source,
                  GLenum type,
@@ -141,6 +461,7 @@ MessageCallback( GLenum source,
 
 }
 void initialize_game(GLFWwindow* window) {
+    PROFILE_FUNCTION();
 #ifdef __DEBUG__
     glEnable(GL_DEBUG_OUTPUT);
     glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
@@ -153,58 +474,115 @@ void initialize_game(GLFWwindow* window) {
     glEnable(GL_CULL_FACE);
     glEnable(GL_BLEND);
 
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glfwSwapBuffers(window);
+    // headless windows have no context of their own and no default framebuffer to clear
+    if (glfwGetWindowAttrib(window, GLFW_CLIENT_API) != GLFW_NO_API) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glfwSwapBuffers(window);
+    }
 
-    // set up first pass frame buffer
-    glGenFramebuffers(1, &semitransparent_pass_fb);
-    glBindFramebuffer(GL_FRAMEBUFFER, semitransparent_pass_fb);
+    // set up first pass frame buffer, the attachments are sized to the framebuffer in resize_render_targets
+    glCreateFramebuffers(1, &semitransparent_pass_fb);
 
+    OitFormatSet formats = oitFormats(render_settings.oit_formats);
     // texture for opaque pass and color modulation
-    glGenRenderbuffers(1, &oit_color_buffer);
-    glBindRenderbuffer(GL_RENDERBUFFER, oit_color_buffer);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA32F, DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, oit_color_buffer);
-
+    oit_color_target = render_targets.create(formats.color, GL_NEAREST);
     // texture for blended transparency color accumulation
-    glGenTextures(1, &oit_accum_tex);
-    glBindTexture(GL_TEXTURE_2D, oit_accum_tex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT,
-                 0, GL_RGBA, GL_FLOAT, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, oit_accum_tex, 0);
-
+    oit_accum_target = render_targets.create(formats.accumulation);
     // texture for blended real-alpha accumulation (as if using over)
-    glGenTextures(1, &oit_reveal_tex);
-    glBindTexture(GL_TEXTURE_2D, oit_reveal_tex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT,
-                 0, GL_RED, GL_FLOAT, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, oit_reveal_tex, 0);
-
+    oit_reveal_target = render_targets.create(formats.revealage);
+    // depth buffer, a texture so the next frame can build its occlusion pyramid from it
+    oit_depth_target = render_targets.create(GL_DEPTH_COMPONENT32F, GL_NEAREST);
+    for (RenderTargetID target : {oit_color_target, oit_accum_target, oit_reveal_target, oit_depth_target}) {
+        render_targets.setSamples(target, std::max(1, render_settings.msaa_samples));
+    }
+    // what the multisampled targets resolve into, read by the blit, the occlusion pyramid and the upsampler
+    resolved_color_target = render_targets.create(formats.color, GL_NEAREST);
+    resolved_depth_target = render_targets.create(GL_DEPTH_COMPONENT32F, GL_NEAREST);
 
     const GLenum dbs[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
-    glDrawBuffers(3, dbs);
+    glNamedFramebufferDrawBuffers(semitransparent_pass_fb, 3, dbs);
+
+    // lower resolution transparent pass, the attachments are pooled targets picked per frame
+    glCreateFramebuffers(1, &lowres_transparent_fb);
+    glNamedFramebufferDrawBuffers(lowres_transparent_fb, 3, dbs);
+
+    glCreateFramebuffers(1, &resolve_fb);
 
-    // depth buffer
-    glGenRenderbuffers(1, &oit_depth_buffer);
-    glBindRenderbuffer(GL_RENDERBUFFER, oit_depth_buffer);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, oit_depth_buffer);
+    // optical depth and moments of the transparent geometry, tested against the scene depth
+    glCreateFramebuffers(1, &moment_fb);
+    const GLenum moment_dbs[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glNamedFramebufferDrawBuffers(moment_fb, 2, moment_dbs);
+
+    hiz_culler.initialize();
+
+    int job_threads = render_settings.job_threads > 0 ? render_settings.job_threads
+                                                      : int(std::thread::hardware_concurrency());
+    scene_jobs = new JobSystem(std::max(0, job_threads - 1));
+
+    // framebuffer size rather than window size, they differ on HiDPI screens
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    resize_render_targets(framebufferWidth, framebufferHeight);
+    glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
 
 
     // compile shaders
 
+    // material textures are looked up by the lit shaders through material.glsl.
+    // Handles differ between the draws of one multi draw, sampling them needs NV_gpu_shader5
+    bool bindless_materials = render_settings.bindless_textures && GLAD_GL_ARB_bindless_texture
+                              && GLAD_GL_NV_gpu_shader5;
+    std::string material_defines;
+    if (bindless_materials) {
+        material_defines = "#define BINDLESS_MATERIALS";
+    } else if (render_settings.bindless_textures) {
+        std::cerr << "GL_ARB_bindless_texture or GL_NV_gpu_shader5 missing, material textures are copied into texture arrays" << std::endl;
+    }
+
     // general shader (phong)
     opaque_lighting_shader = new Gloom::Shader();
-    opaque_lighting_shader->makeBasicShader("../res/shaders/simple.vert", "../res/shaders/simple.frag");
+    opaque_lighting_shader->attach("../res/shaders/simple.vert");
+    opaque_lighting_shader->attach("../res/shaders/simple.frag", "#define ALPHA_TEST");
+    opaque_lighting_shader->attach("../res/shaders/material.glsl", material_defines, GL_FRAGMENT_SHADER);
+    opaque_lighting_shader->link();
     opaque_lighting_shader->activate();
 
+    // same phong shading, but per-draw data comes from the DrawData buffer of the opaque batch
+    std::string batched_defines;
+    if (GLAD_GL_ARB_shader_draw_parameters) {
+        batched_defines = "#define HAS_DRAW_PARAMETERS";
+    } else {
+        std::cerr << "GL_ARB_shader_draw_parameters missing, opaque pass falls back to one draw per object" << std::endl;
+        render_settings.multi_draw_indirect = false;
+    }
+    opaque_batched_shader = new Gloom::Shader();
+    opaque_batched_shader->attach("../res/shaders/simple_mdi.vert", batched_defines);
+    opaque_batched_shader->attach("../res/shaders/simple.frag");
+    opaque_batched_shader->attach("../res/shaders/material.glsl", material_defines, GL_FRAGMENT_SHADER);
+    opaque_batched_shader->link();
+    opaque_batched_shader->activate();
+
+    // batched materials with holes, discard keeps these out of the early-z path
+    opaque_alphatest_shader = new Gloom::Shader();
+    opaque_alphatest_shader->attach("../res/shaders/simple_mdi.vert", batched_defines);
+    opaque_alphatest_shader->attach("../res/shaders/simple.frag", "#define ALPHA_TEST");
+    opaque_alphatest_shader->attach("../res/shaders/material.glsl", material_defines, GL_FRAGMENT_SHADER);
+    opaque_alphatest_shader->link();
+    opaque_alphatest_shader->activate();
+
+    // position only, lays down the opaque depth before shading
+    depth_prepass_shader = new Gloom::Shader();
+    depth_prepass_shader->attach("../res/shaders/depth_only.vert", batched_defines);
+    depth_prepass_shader->link();
+    depth_prepass_shader->activate();
+
     // oit pass shader (phong)
     blending_lighting_shader = new Gloom::Shader();
-    blending_lighting_shader->makeBasicShader("../res/shaders/simple.vert", "../res/shaders/oit.frag");
+    blending_lighting_shader->attach("../res/shaders/simple.vert");
+    blending_lighting_shader->attach("../res/shaders/oit.frag");
+    blending_lighting_shader->attach("../res/shaders/moment_oit.frag");
+    blending_lighting_shader->attach("../res/shaders/material.glsl", material_defines, GL_FRAGMENT_SHADER);
+    blending_lighting_shader->link();
     blending_lighting_shader->activate();
 
     // text / UI / 2d shader
@@ -216,7 +594,10 @@ void initialize_game(GLFWwindow* window) {
     fur_shell_shader = new Gloom::Shader();
     fur_shell_shader->attach("../res/shaders/fur.vert");
     fur_shell_shader->attach("../res/shaders/fur_shell.frag");
+    fur_shell_shader->attach("../res/shaders/moment_oit.frag");
     fur_shell_shader->attach("../res/shaders/fur_shell.geom");
+    fur_shell_shader->attach("../res/shaders/material.glsl", material_defines, GL_FRAGMENT_SHADER);
+    fur_shell_shader->attach("../res/shaders/material.glsl", material_defines, GL_GEOMETRY_SHADER);
     fur_shell_shader->link();
     fur_shell_shader->activate();
 
@@ -224,10 +605,23 @@ void initialize_game(GLFWwindow* window) {
     fur_fin_shader = new Gloom::Shader();
     fur_fin_shader->attach("../res/shaders/fur.vert");
     fur_fin_shader->attach("../res/shaders/fur_fin.frag");
+    fur_fin_shader->attach("../res/shaders/moment_oit.frag");
     fur_fin_shader->attach("../res/shaders/fur_fin.geom");
+    fur_fin_shader->attach("../res/shaders/material.glsl", material_defines, GL_FRAGMENT_SHADER);
+    fur_fin_shader->attach("../res/shaders/material.glsl", material_defines, GL_GEOMETRY_SHADER);
     fur_fin_shader->link();
     fur_fin_shader->activate();
 
+    // shells as coverage masked opaque layers, for msaa without blending
+    fur_shell_coverage_shader = new Gloom::Shader();
+    fur_shell_coverage_shader->attach("../res/shaders/fur.vert");
+    fur_shell_coverage_shader->attach("../res/shaders/fur_shell.frag", "#define ALPHA_TO_COVERAGE");
+    fur_shell_coverage_shader->attach("../res/shaders/fur_shell.geom");
+    fur_shell_coverage_shader->attach("../res/shaders/material.glsl", material_defines, GL_FRAGMENT_SHADER);
+    fur_shell_coverage_shader->attach("../res/shaders/material.glsl", material_defines, GL_GEOMETRY_SHADER);
+    fur_shell_coverage_shader->link();
+    fur_shell_coverage_shader->activate();
+
     // shader for position invariant skybox
     skybox_shader = new Gloom::Shader();
     skybox_shader->attach("../res/shaders/skybox.vert");
@@ -242,19 +636,38 @@ void initialize_game(GLFWwindow* window) {
     compositing_shader->link();
     compositing_shader->activate();
 
+    // composits a lower resolution transparent pass, with a depth aware upsample
+    upsampling_compositing_shader = new Gloom::Shader();
+    upsampling_compositing_shader->attach("../res/shaders/compositor.vert");
+    upsampling_compositing_shader->attach("../res/shaders/compositor.frag", "#define BILATERAL_UPSAMPLE");
+    upsampling_compositing_shader->link();
+    upsampling_compositing_shader->activate();
+
+    // composits the moment based transparency, revealage comes from the summed optical depth
+    moment_compositing_shader = new Gloom::Shader();
+    moment_compositing_shader->attach("../res/shaders/compositor.vert");
+    moment_compositing_shader->attach("../res/shaders/compositor.frag", "#define MOMENT_BASED");
+    moment_compositing_shader->link();
+    moment_compositing_shader->activate();
+
+    // composits multisampled targets sample by sample into the resolved target
+    msaa_resolve_shader = new Gloom::Shader();
+    msaa_resolve_shader->attach("../res/shaders/compositor.vert");
+    msaa_resolve_shader->attach("../res/shaders/compositor_msaa.frag");
+    msaa_resolve_shader->link();
+    msaa_resolve_shader->activate();
+
 
     // gen meshes
-    Mesh pad = cube(padDimensions, glm::vec2(30, 40), true);
-    Mesh box = cube(boxDimensions, glm::vec2(90), true, true);
+    MeshHandle padMesh = resource_cache.mesh(
+            fmt::format("cube {} {} {} 30x40 tiling", padDimensions.x, padDimensions.y, padDimensions.z),
+            [] { return cube(padDimensions, glm::vec2(30, 40), true); });
 
-    const float textwidth = 400;
     const float textratio = 1.34482759f;
 
 
     // Generated meshes
-    Mesh text_mesh = generateTextGeometryBuffer("Click to start", textratio, textwidth);
-    unsigned int boxVAO  = generateBuffer(box);
-    unsigned int padVAO  = generateBuffer(pad);
+    Mesh text_mesh = generateTextGeometryBuffer("Click to start", textratio, text_width);
     unsigned int textVAO = generateBuffer(text_mesh);
 
     // Construct scene
@@ -272,16 +685,13 @@ void initialize_game(GLFWwindow* window) {
     compositeNode = new CompositorNode();
 
     // special case textures IDs
-    textNode->textureID = create_texture("../res/textures/charmap.png");
+    textNode->texture = resource_cache.texture("../res/textures/charmap.png");
 
-    padNode->normalMapID = create_texture("../res/textures/paddle_nrm.png");
-    padNode->textureID   = create_texture("../res/textures/paddle_col.png");
-    padNode->roughnessID = create_texture("../res/textures/paddle_rgh.png");
+    padNode->loadTextures("paddle");
     padNode->render_pass = SEMITRANSPARENT;
 
-    skyBoxNode->textureID = create_cubemap("../res/textures/skybox/");
-
-    rootNode->children.push_back(skyBoxNode);
+    // not part of the graph, drawn as its own stage after the opaque pass
+    skyBoxNode->texture = resource_cache.cubemap("../res/textures/skybox/");
 
     rootNode->children.push_back(sunNode);
 
@@ -297,9 +707,10 @@ void initialize_game(GLFWwindow* window) {
     TexturedGeometry *pch1 = new TexturedGeometry();
     TexturedGeometry *pch2 = new TexturedGeometry();
     TexturedGeometry *pch3 = new TexturedGeometry();
-    pch1->textureID = pch2->textureID = pch3->textureID = padNode->textureID;
-    pch1->roughnessID = pch2->roughnessID = pch3->roughnessID = padNode->roughnessID;
-    pch1->normalMapID = pch2->normalMapID = pch3->normalMapID = padNode->normalMapID;
+    for (TexturedGeometry *pch : {pch1, pch2, pch3}) {
+        pch->setMesh(padMesh);
+        pch->loadTextures("paddle");
+    }
     pch1->position = pch2->position = pch3->position = {0, -5, 0};
     pch1->rotation = pch2->rotation = pch3->rotation = {1, 1, 0};
     pch1->render_pass = pch2->render_pass = pch3->render_pass = padNode->render_pass;
@@ -314,18 +725,17 @@ void initialize_game(GLFWwindow* window) {
 
     // gen meshes
 
-    skyBoxNode->vaoID  = boxVAO;
-    skyBoxNode->vaoIndicesSize        = box.indices.size();
+    // the fullscreen triangle is generated from gl_VertexID, core profile still wants a vao bound
+    GLuint emptyVAO;
+    glCreateVertexArrays(1, &emptyVAO);
+    skyBoxNode->vaoID  = emptyVAO;
+    skyBoxNode->vaoIndicesSize        = 3;
 
-    padNode->vaoID  = padVAO;
-    padNode->vaoIndicesSize        = pad.indices.size();
+    padNode->setMesh(padMesh);
 
     textNode->vaoID = textVAO;
     textNode->vaoIndicesSize       = text_mesh.indices.size();
 
-    pch1->vaoID = pch2->vaoID = pch3->vaoID = padNode->vaoID;
-    pch1->vaoIndicesSize = pch2->vaoIndicesSize = pch3->vaoIndicesSize = padNode->vaoIndicesSize;
-
     Mesh compositeMesh;
     compositeMesh.vertices = {{-1,-1,0.5}, {1,-1,0.5}, {-1,1,0.5}, {1,1,0.5}};
     compositeMesh.indices = {0,1,2, 1,3,2};
@@ -339,12 +749,10 @@ void initialize_game(GLFWwindow* window) {
     sunNode->position = {0, 5000, 0};
 
     // geometry positions
-    textNode->position = { DEFAULT_WINDOW_WIDTH/2 - textwidth/2, DEFAULT_WINDOW_HEIGHT/2, 0};
+    place_ui();
 
     rickyFurNode->position = {-50, 20, -90};
 
-    skyBoxNode->position = {0, 0, 0 };
-
     terrainNode->position = {0, 0, 0};
     broadTerrainNode->position = {0, 40, 0};
 
@@ -366,52 +774,68 @@ void initialize_game(GLFWwindow* window) {
     sunNode->lightColor = {1, 1, 0.5};
     sunNode->lightColor *= 2000;
 
-    // find uniform locations
-    for (auto node : {topLeftLightNode, topRightLightNode, padLightNode, sunNode}) {
-        std::string poslocname = fmt::format("{}[{}].{}", UNIFORM_POINT_LIGHT_SOURCES_NAME, node->lightID,
-                                             UNIFORM_POINT_LIGHT_SOURCES_POSITION_NAME);
-        uniform_light_sources_position_loc[node->lightID] = opaque_lighting_shader->getUniformFromName(poslocname);
-        std::string collocname = fmt::format("{}[{}].{}", UNIFORM_POINT_LIGHT_SOURCES_NAME, node->lightID,
-                                             UNIFORM_POINT_LIGHT_SOURCES_COLOR_NAME);
-        uniform_light_sources_color_loc[node->lightID] = opaque_lighting_shader->getUniformFromName(collocname);
-    }
-    for (auto node : {topLeftLightNode, topRightLightNode, padLightNode, sunNode}) {
-        std::string poslocname = fmt::format("{}[{}].{}", UNIFORM_POINT_LIGHT_SOURCES_NAME, node->lightID,
-                                             UNIFORM_POINT_LIGHT_SOURCES_POSITION_NAME);
-        uniform_oit_light_sources_position_loc[node->lightID] = blending_lighting_shader->getUniformFromName(poslocname);
-        std::string collocname = fmt::format("{}[{}].{}", UNIFORM_POINT_LIGHT_SOURCES_NAME, node->lightID,
-                                             UNIFORM_POINT_LIGHT_SOURCES_COLOR_NAME);
-        uniform_oit_light_sources_color_loc[node->lightID] = blending_lighting_shader->getUniformFromName(collocname);
-    }
-    for (auto node : {topLeftLightNode, topRightLightNode, padLightNode, sunNode}) {
-        std::string poslocname = fmt::format("{}[{}].{}", UNIFORM_POINT_LIGHT_SOURCES_NAME, node->lightID,
-                                             UNIFORM_POINT_LIGHT_SOURCES_POSITION_NAME);
-        fur_shell_uniform_light_sources_position_loc[node->lightID] = fur_shell_shader->getUniformFromName(poslocname);
-        std::string collocname = fmt::format("{}[{}].{}", UNIFORM_POINT_LIGHT_SOURCES_NAME, node->lightID,
-                                             UNIFORM_POINT_LIGHT_SOURCES_COLOR_NAME);
-        fur_shell_uniform_light_sources_color_loc[node->lightID] = fur_shell_shader->getUniformFromName(collocname);
-    }
-    for (auto node : {topLeftLightNode, topRightLightNode, padLightNode, sunNode}) {
-        std::string poslocname = fmt::format("{}[{}].{}", UNIFORM_POINT_LIGHT_SOURCES_NAME, node->lightID,
-                                             UNIFORM_POINT_LIGHT_SOURCES_POSITION_NAME);
-        fur_fin_uniform_light_sources_position_loc[node->lightID] = fur_fin_shader->getUniformFromName(poslocname);
-        std::string collocname = fmt::format("{}[{}].{}", UNIFORM_POINT_LIGHT_SOURCES_NAME, node->lightID,
-                                             UNIFORM_POINT_LIGHT_SOURCES_COLOR_NAME);
-        fur_fin_uniform_light_sources_color_loc[node->lightID] = fur_fin_shader->getUniformFromName(collocname);
-    }
+    frame_data_ring.reserve(sizeof(FrameData));
+
+    registerCulling(rootNode);
+    material_table.upload(bindless_materials);
 
     getTimeDeltaSeconds();
 
     std::cout << fmt::format("Initialized scene with {} SceneNodes.", totalChildren(rootNode)) << std::endl;
+    std::cout << "Resources: ";
+    resource_cache.report(std::cout);
 
     std::cout << "Ready. Click to start!" << std::endl;
     cameraPosition = glm::vec3(0, 0, 0);
     cameraRotation = glm::vec3(0, 0, 0);
 }
 
+void setFixedTimestep(double seconds) {
+    fixed_timestep = seconds;
+}
+
+void setCameraPath(const CameraPath *path) {
+    camera_path = path;
+}
+
+void setOutputFramebuffer(GLuint framebuffer) {
+    output_framebuffer = framebuffer;
+}
+
+void startHotReload(GLFWwindow* window) {
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    hot_reload_context = glfwCreateWindow(1, 1, "hot reload", nullptr, window);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    HotReloader::ContextBinder bind;
+    if (hot_reload_context) {
+        bind = [](bool current) { glfwMakeContextCurrent(current ? hot_reload_context : nullptr); };
+    } else {
+        std::cerr << "No shared context, shaders are rebuilt on the render thread" << std::endl;
+    }
+    if (!hot_reloader.start({"../res/shaders", "../res/textures", "../res/textures/skybox"}, bind)) return;
+
+    for (Gloom::Shader* shader : {opaque_lighting_shader, opaque_batched_shader, opaque_alphatest_shader,
+                                  depth_prepass_shader, blending_lighting_shader, flat_geometry_shader,
+                                  fur_shell_shader, fur_fin_shader, fur_shell_coverage_shader, msaa_resolve_shader,
+                                  skybox_shader, compositing_shader, upsampling_compositing_shader,
+                                  moment_compositing_shader}) {
+        hot_reloader.watch(shader);
+    }
+    for (Gloom::Shader* shader : hiz_culler.shaders()) hot_reloader.watch(shader);
+    std::cout << "Watching res/shaders and res/textures for changes" << std::endl;
+}
+
+void stopHotReload() {
+    hot_reloader.stop();
+    if (hot_reload_context) glfwDestroyWindow(hot_reload_context);
+    hot_reload_context = nullptr;
+}
+
 void updateFrame(GLFWwindow* window) {
+    PROFILE_FUNCTION();
+    frame_pacer.beginFrame(render_settings.frames_in_flight);
 
-    float timeDelta = getTimeDeltaSeconds();
+    float timeDelta = fixed_timestep > 0 ? fixed_timestep : getTimeDeltaSeconds();
 
     glm::vec3 camera_position_delta = glm::vec3(0,0,0);
     glm::vec3 camera_rotation_delta = glm::vec3(0,0,0);
@@ -469,12 +893,16 @@ void updateFrame(GLFWwindow* window) {
 
     glm::mat4 projection = glm::perspective(
         glm::radians(80.0f),
-        float(DEFAULT_WINDOW_WIDTH) / float(DEFAULT_WINDOW_HEIGHT), //todo dynamic aspect
-        0.1f,
-        4000.f
+        float(render_targets.outputWidth()) / float(render_targets.outputHeight()),
+        near_plane,
+        far_plane
     );
 
     cameraRotation += camera_rotation_delta;
+    if (camera_path) {
+        camera_path->sample(realTime - debug_startTime, cameraPosition, cameraRotation);
+        camera_position_delta = glm::vec3(0,0,0);
+    }
     if(cameraRotation.x > glm::radians(90.f)){
         cameraRotation.x = glm::radians(90.f);
     } else if (cameraRotation.x < glm::radians(-90.f)){
@@ -486,6 +914,7 @@ void updateFrame(GLFWwindow* window) {
     rotation = glm::rotate(rotation, cameraRotation.y, glm::vec3(0,1,0));
 
     VP = projection * rotation;
+    projected_scale = projection[1][1] * 0.5f * render_targets.outputHeight();
 
     glm::mat4 cam_rot_mat = glm::rotate(-cameraRotation.y, glm::vec3(0,1,0));
     glm::vec4 camera_position_delta4 = cam_rot_mat * glm::vec4(camera_position_delta, 1);
@@ -505,55 +934,25 @@ void updateFrame(GLFWwindow* window) {
     };
 
     rootNode->update(glm::identity<glm::mat4>());
-    opaque_lighting_shader->activate();
-    glUniform3fv(UNIFORM_CAMPOS_LOC, 1, glm::value_ptr(cameraPosition));
-    blending_lighting_shader->activate();
-    glUniform3fv(UNIFORM_CAMPOS_LOC, 1, glm::value_ptr(cameraPosition));
-    fur_shell_shader->activate();
-    glUniform3fv(UNIFORM_CAMPOS_LOC, 1, glm::value_ptr(cameraPosition));
-    fur_fin_shader->activate();
-    glUniform3fv(UNIFORM_CAMPOS_LOC, 1, glm::value_ptr(cameraPosition));
+    scene_bvh.refit();
 
+    frame_data.camera_pos = cameraPosition;
+    frame_data.wind = wind;
+    // the only point the cpu waits for the gpu, everything above overlaps with the frames still being drawn
+    frame_pacer.waitForSlot();
+    if (void *slot = frame_data_ring.slot(frame_pacer.slot())) std::memcpy(slot, &frame_data, sizeof(FrameData));
 }
 
-void PointLight::update(glm::mat4 transformationThusFar) {
-    // find total position in graph by model matrix
-    glm::vec4 lightpos = modelTF * glm::vec4(0, 0, 0, 1);
-
-    opaque_lighting_shader->activate();
-    glUniform3fv(uniform_light_sources_position_loc[lightID], 1, glm::value_ptr(lightpos));
-    glUniform3fv(uniform_light_sources_color_loc[lightID], 1, glm::value_ptr(lightColor));
-    blending_lighting_shader->activate();
-    glUniform3fv(uniform_oit_light_sources_position_loc[lightID], 1, glm::value_ptr(lightpos));
-    glUniform3fv(uniform_oit_light_sources_color_loc[lightID], 1, glm::value_ptr(lightColor));
-    fur_shell_shader->activate();
-    glUniform3fv(fur_shell_uniform_light_sources_position_loc[lightID], 1, glm::value_ptr(lightpos));
-    glUniform3fv(fur_shell_uniform_light_sources_color_loc[lightID], 1, glm::value_ptr(lightColor));
-    fur_fin_shader->activate();
-    glUniform3fv(fur_fin_uniform_light_sources_position_loc[lightID], 1, glm::value_ptr(lightpos));
-    glUniform3fv(fur_fin_uniform_light_sources_color_loc[lightID], 1, glm::value_ptr(lightColor));
+void LightNode::update(glm::mat4 transformationThusFar) {
     SceneNode::update(transformationThusFar);
-}
-
-void DirLight::update(glm::mat4 transformationThusFar) {
     // find total position in graph by model matrix
-    glm::vec4 lightpos = modelTF * glm::vec4(0, 0, 0, 1);
-
-    opaque_lighting_shader->activate();
-    glUniform3fv(uniform_light_sources_position_loc[lightID], 1, glm::value_ptr(lightpos));
-    glUniform3fv(uniform_light_sources_color_loc[lightID], 1, glm::value_ptr(lightColor));
-    blending_lighting_shader->activate();
-    glUniform3fv(uniform_oit_light_sources_position_loc[lightID], 1, glm::value_ptr(lightpos));
-    glUniform3fv(uniform_oit_light_sources_color_loc[lightID], 1, glm::value_ptr(lightColor));
-    fur_shell_shader->activate();
-    glUniform3fv(fur_shell_uniform_light_sources_position_loc[lightID], 1, glm::value_ptr(lightpos));
-    glUniform3fv(fur_shell_uniform_light_sources_color_loc[lightID], 1, glm::value_ptr(lightColor));
-    fur_fin_shader->activate();
-    glUniform3fv(fur_shell_uniform_light_sources_position_loc[lightID], 1, glm::value_ptr(lightpos));
-    glUniform3fv(fur_shell_uniform_light_sources_color_loc[lightID], 1, glm::value_ptr(lightColor));
-    SceneNode::update(transformationThusFar);
+    PointLightSource &source = frame_data.point_light_sources[lightID];
+    source.position = glm::vec3(modelTF * glm::vec4(0, 0, 0, 1));
+    source.color = lightColor;
 }
+
 void SceneNode::update(glm::mat4 transformationThusFar) {
+    PROFILE_ZONE("SceneNode::update");
     glm::mat4 transformationMatrix =
               glm::translate(position)
             * glm::translate(referencePoint)
@@ -565,22 +964,52 @@ void SceneNode::update(glm::mat4 transformationThusFar) {
 
     modelTF = transformationThusFar * transformationMatrix;
 
+    // big subtrees go to the job system, the rest are updated right here while they run
+    JobSystem::Counter counter;
     for(SceneNode* child : children) {
-        child->update( modelTF);
+        if (child->subtreeSize >= parallel_subtree_size) {
+            scene_jobs->run(counter, [child, this] { child->update(modelTF); });
+        } else {
+            child->update(modelTF);
+        }
     }
+    scene_jobs->wait(counter);
+}
+
+void Geometry::update(glm::mat4 transformationThusFar) {
+    SceneNode::update(transformationThusFar);
+    if (cullingID < 0) return;
+
+    float padding = boundsPadding();
+    worldBounds = transformAABB(meshRange.bounds.inflated(padding), modelTF);
+    BoundingSphere sphere = meshRange.sphere;
+    sphere.radius += padding;
+    worldSphere = transformSphere(sphere, modelTF);
+    scene_bvh.update(cullingID, worldBounds);
+}
+
+float FurredGeometry::boundsPadding() const {
+    return fin_strand_length_fac * strand_length;
 }
 
 void CompositorNode::render(render_type pass) {
     if(render_pass == pass && vaoID != -1) {
-        glm::mat4 mvp = VP * modelTF;
-        glm::mat3 normal_matrix = glm::transpose(glm::inverse(modelTF));
-        compositing_shader->activate();
-
-        glBindTextureUnit(ACCUMULATION_SAMPLER, oit_accum_tex);
-        glBindTextureUnit(REVEALAGE_SAMPLER, oit_reveal_tex);
+        if (transparent_targets.moment_based) {
+            moment_compositing_shader->activate();
+        } else if (transparent_targets.lowres) {
+            upsampling_compositing_shader->activate();
+            glBindTextureUnit(MODULATION_SAMPLER, transparent_targets.modulation);
+            glBindTextureUnit(LOWRES_DEPTH_SAMPLER, transparent_targets.depth);
+            glBindTextureUnit(SCENE_DEPTH_SAMPLER, scene_depth_texture());
+        } else {
+            compositing_shader->activate();
+        }
+        glBindTextureUnit(ACCUMULATION_SAMPLER, transparent_targets.accum);
+        glBindTextureUnit(REVEALAGE_SAMPLER, transparent_targets.reveal);
 
         glBindVertexArray(vaoID);
         glDrawElements(GL_TRIANGLES, vaoIndicesSize, GL_UNSIGNED_INT, nullptr);
+        draw_stats.count();
     }
 }
 
@@ -590,16 +1019,20 @@ void SceneNode::render(render_type pass) {
     }
 }
 
+// Drawn after the opaque geometry at the far plane, so the sky is only shaded where it is visible
 void Skybox::render(render_type pass) {
     if(render_pass == pass && vaoID != -1) {
-        glm::mat4 mvp = VP; // no model
+        glm::mat4 vp = VP; // no model
         // undo camera translation
-        mvp = glm::translate(mvp, -cameraPosition);
+        vp = glm::translate(vp, -cameraPosition);
         skybox_shader->activate();
-        glUniformMatrix4fv(UNIFORM_MVP_LOC, 1, GL_FALSE, glm::value_ptr(mvp));
-        glBindTextureUnit(SKYBOX_CUBE_SAMPLER, textureID);
+        glUniformMatrix4fv(UNIFORM_MVP_LOC, 1, GL_FALSE, glm::value_ptr(glm::inverse(vp)));
+        glBindTextureUnit(SKYBOX_CUBE_SAMPLER, textureName(texture));
         glBindVertexArray(vaoID);
-        glDrawElements(GL_TRIANGLES, vaoIndicesSize, GL_UNSIGNED_INT, nullptr);
+        glDepthMask(GL_FALSE);
+        glDrawArrays(GL_TRIANGLES, 0, vaoIndicesSize);
+        draw_stats.count();
+        glDepthMask(GL_TRUE);
     }
     for(SceneNode* child : children) {
         child->render(pass);
@@ -607,67 +1040,62 @@ void Skybox::render(render_type pass) {
 }
 
 void Geometry::render(render_type pass) {
-    if(render_pass == pass && vaoID != -1) {
-        glm::mat4 mvp = VP * modelTF;
-        glm::mat3 normal_matrix = glm::transpose(glm::inverse(modelTF));
+    if(!visible) {
+        // culled, but children have their own bounds
+    } else if(render_pass == pass && pass == OPAQUE && pooled) {
+        // already in opaque_batch, see buildDrawPackets
+    } else if(render_pass == pass && hasMesh()) {
         if(render_pass == SEMITRANSPARENT) blending_lighting_shader->activate();
         else opaque_lighting_shader->activate();
-        glUniform1i(UNIFORM_ENABLE_NMAP_LOC, 0);
-        glUniformMatrix4fv(UNIFORM_MVP_LOC, 1, GL_FALSE, glm::value_ptr(mvp));
-        glUniformMatrix4fv(UNIFORM_MODEL_LOC, 1, GL_FALSE, glm::value_ptr(modelTF));
-        glUniformMatrix3fv(UNIFORM_NORMAL_MATRIX_LOC, 1, GL_FALSE, glm::value_ptr(normal_matrix));
+        draw_data.bind(drawID);
 
-        glBindVertexArray(vaoID);
-        glDrawElements(GL_TRIANGLES, vaoIndicesSize, GL_UNSIGNED_INT, nullptr);
+        drawMesh();
     }
     SceneNode::render(pass);
 }
 
 
+bool coverageShells() {
+    return render_settings.alpha_to_coverage_shells && multisampled();
+}
+
+void FurredGeometry::drawShells(bool coverage) {
+    GpuZone zone(gpu_profiler, render_settings.profile_nodes ? "fur shells " + name : "fur shells");
+    // draw shells of fur volume
+    if (coverage) fur_shell_coverage_shader->activate();
+    else fur_shell_shader->activate();
+    draw_data.bind(drawID);
+
+    drawMesh();
+}
+
+void FurredGeometry::drawFins() {
+    GpuZone zone(gpu_profiler, render_settings.profile_nodes ? "fur fins " + name : "fur fins");
+    // draw silhouette fins
+    // these should be a little longer to match length and  stick out a little,
+    // so the texture has a little room at the top
+    glDisable(GL_CULL_FACE);
+    fur_fin_shader->activate();
+    draw_data.bind(drawID);
+
+    drawMesh();
+
+    glEnable(GL_CULL_FACE);
+}
+
 void FurredGeometry::render(render_type pass) {
-    if(vaoID != -1) {
+    if(hasMesh() && visible) {
         if (render_pass == pass){
-            // draw shells of fur volume
-            glm::mat4 mvp = VP * modelTF;
-            glm::mat3 normal_matrix = glm::transpose(glm::inverse(modelTF));
-            fur_shell_shader->activate();
-            glUniformMatrix4fv(UNIFORM_MVP_LOC, 1, GL_FALSE, glm::value_ptr(mvp));
-            glUniformMatrix4fv(UNIFORM_MODEL_LOC, 1, GL_FALSE, glm::value_ptr(modelTF));
-            glUniformMatrix3fv(UNIFORM_NORMAL_MATRIX_LOC, 1, GL_FALSE, glm::value_ptr(normal_matrix));
-            glUniform1f(UNIFORM_FUR_LENGTH_LOC, strand_length);
-            glUniform3fv(UNIFORM_WIND_LOC, 1, glm::value_ptr(wind));
-
-            glBindTextureUnit(SIMPLE_TEXTURE_SAMPLER, textureID);
-            glBindTextureUnit(SIMPLE_NORMAL_SAMPLER, furNormalMapID);
-            glBindTextureUnit(SIMPLE_ROUGHNESS_SAMPLER, roughnessID);
-            glBindTextureUnit(FUR_FUR_SAMPLER, furID);
-            glBindTextureUnit(FUR_TURBULENCE_SAMPLER, furTurbulenceID);
-
-            glBindVertexArray(vaoID);
-            glDrawElements(GL_TRIANGLES, vaoIndicesSize, GL_UNSIGNED_INT, nullptr);
-
-            // draw silhouette fins
-            // these should be a little longer to match length and  stick out a little,
-            // so the texture has a little room at the top
-            float fin_strand_length_fac = 1.2;
-            glDisable(GL_CULL_FACE);
-            fur_fin_shader->activate();
-            glUniformMatrix4fv(UNIFORM_MVP_LOC, 1, GL_FALSE, glm::value_ptr(mvp));
-            glUniformMatrix4fv(UNIFORM_MODEL_LOC, 1, GL_FALSE, glm::value_ptr(modelTF));
-            glUniformMatrix3fv(UNIFORM_NORMAL_MATRIX_LOC, 1, GL_FALSE, glm::value_ptr(normal_matrix));
-            glUniform1f(UNIFORM_FUR_LENGTH_LOC, fin_strand_length_fac*strand_length);
-            glUniform3fv(UNIFORM_WIND_LOC, 1, glm::value_ptr(wind));
-
-            glBindTextureUnit(SIMPLE_TEXTURE_SAMPLER, strandTextureID);
-            glBindTextureUnit(FUR_FUR_SAMPLER, furID);
-
-            glDrawElements(GL_TRIANGLES, vaoIndicesSize, GL_UNSIGNED_INT, nullptr);
-
-            glEnable(GL_CULL_FACE);
+            // coverage shells were already drawn in the opaque pass
+            if (!coverageShells()) drawShells(false);
+            drawFins();
 
         } else if (pass == OPAQUE) {
-            // draw base in opaque pass
+            // coverage shells have to wait for the opaque batch, they depth test against it
+            if (coverageShells()) coverage_shells.push_back(this);
+            // draw base in opaque pass, this also renders the children
             TexturedGeometry::render(OPAQUE);
+            return;
         }
     }
     for(SceneNode* child : children) {
@@ -675,22 +1103,54 @@ void FurredGeometry::render(render_type pass) {
     }
 }
 
+void TexturedGeometry::registerMaterials(MaterialTable &table) {
+    Material surface;
+    surface.textures[MATERIAL_COLOR] = textureName(colorMap);
+    surface.textures[MATERIAL_NORMAL] = textureName(normalMap);
+    surface.textures[MATERIAL_ROUGHNESS] = textureName(roughnessMap);
+    surface.flags = MATERIAL_FLAG_TEXTURED;
+    materials[SURFACE_MATERIAL] = table.add(surface);
+}
+
+void FurredGeometry::registerMaterials(MaterialTable &table) {
+    TexturedGeometry::registerMaterials(table);
+    Material shell;
+    shell.textures[MATERIAL_COLOR] = textureName(colorMap);
+    shell.textures[MATERIAL_NORMAL] = textureName(furNormalMap);
+    shell.textures[MATERIAL_ROUGHNESS] = textureName(roughnessMap);
+    shell.textures[MATERIAL_FUR] = textureName(furMap);
+    shell.textures[MATERIAL_TURBULENCE] = textureName(furTurbulenceMap);
+    shell.fur_length = strand_length;
+    materials[SHELL_MATERIAL] = table.add(shell);
+
+    // fins are textured with a strand running up the billboard
+    Material fin;
+    fin.textures[MATERIAL_COLOR] = textureName(strandMap);
+    fin.textures[MATERIAL_ROUGHNESS] = textureName(roughnessMap);
+    fin.textures[MATERIAL_FUR] = textureName(furMap);
+    fin.fur_length = fin_strand_length_fac * strand_length;
+    materials[FIN_MATERIAL] = table.add(fin);
+}
+
+BatchMaterial TexturedGeometry::batchMaterial() const {
+    BatchMaterial material;
+    material.materialID = materials[SURFACE_MATERIAL];
+    // a color map with holes is drawn with discard, read every frame as a reload can change it
+    material.alpha_tested = colorMap && colorMap->has_transparency;
+    return material;
+}
+
 void TexturedGeometry::render(render_type pass) {
-    if(render_pass == pass && vaoID != -1) {
-        glm::mat4 mvp = VP * modelTF;
-        glm::mat3 normal_matrix = glm::transpose(glm::inverse(modelTF));
+    if(!visible) {
+        // culled, but children have their own bounds
+    } else if(render_pass == pass && pass == OPAQUE && pooled) {
+        // already in opaque_batch, see buildDrawPackets
+    } else if(render_pass == pass && hasMesh()) {
         if(render_pass == SEMITRANSPARENT) blending_lighting_shader->activate();
         else opaque_lighting_shader->activate();
-        glUniform1i(UNIFORM_ENABLE_NMAP_LOC, 1);
-        glUniformMatrix4fv(UNIFORM_MVP_LOC, 1, GL_FALSE, glm::value_ptr(mvp));
-        glUniformMatrix4fv(UNIFORM_MODEL_LOC, 1, GL_FALSE, glm::value_ptr(modelTF));
-        glUniformMatrix3fv(UNIFORM_NORMAL_MATRIX_LOC, 1, GL_FALSE, glm::value_ptr(normal_matrix));
-        glBindTextureUnit(SIMPLE_NORMAL_SAMPLER, normalMapID);
-        glBindTextureUnit(SIMPLE_TEXTURE_SAMPLER, textureID);
-        glBindTextureUnit(SIMPLE_ROUGHNESS_SAMPLER, roughnessID);
+        draw_data.bind(drawID);
 
-        glBindVertexArray(vaoID);
-        glDrawElements(GL_TRIANGLES, vaoIndicesSize, GL_UNSIGNED_INT, nullptr);
+        drawMesh();
     }
     for(SceneNode* child : children) {
         child->render(pass);
@@ -700,25 +1160,145 @@ void TexturedGeometry::render(render_type pass) {
 void FlatGeometry::render(render_type pass) {
     if(render_pass == pass && vaoID != -1) {
         flat_geometry_shader->activate();
-        glm::mat4 ortho = glm::ortho(0.f, (float)DEFAULT_WINDOW_WIDTH, 0.f, (float)DEFAULT_WINDOW_HEIGHT, -1.f, 1.f);
+        glm::mat4 ortho = glm::ortho(0.f, (float)render_targets.outputWidth(), 0.f, (float)render_targets.outputHeight(), -1.f, 1.f);
         ortho = ortho * modelTF;
         glUniformMatrix4fv(UNIFORM_MVP_LOC, 1, GL_FALSE, glm::value_ptr(ortho));
 
-        glBindTextureUnit(TEX_TEXT_SAMPLER, textureID);
+        glBindTextureUnit(TEX_TEXT_SAMPLER, textureName(texture));
         glBindVertexArray(vaoID);
         glDrawElements(GL_TRIANGLES, vaoIndicesSize, GL_UNSIGNED_INT, nullptr);
+        draw_stats.count();
     }
     for(SceneNode* child : children) {
         child->render(pass);
     }
 }
 
+// Sets which outputs the transparent shaders write, see moment_oit.frag
+void setTransparencyMode(int mode) {
+    glm::vec2 logDepthRange(std::log(near_plane), std::log(far_plane));
+    for (auto shader : {blending_lighting_shader, fur_shell_shader, fur_fin_shader}) {
+        shader->activate();
+        glUniform1i(UNIFORM_TRANSPARENCY_MODE_LOC, mode);
+        glUniform2fv(UNIFORM_LOG_DEPTH_RANGE_LOC, 1, glm::value_ptr(logDepthRange));
+    }
+}
+
+// Moment based transparency, the SEMITRANSPARENT pass is drawn twice.
+// First the optical depth and depth moments of every fragment are summed into pooled targets,
+// then each fragment is weighted by the transmittance the moments reconstruct in front of it.
+// Leaves the oit framebuffer bound with the accumulation written and transparent_targets pointing at the results.
+void drawMomentTransparency(int width, int height) {
+    GLuint opticalDepth = render_targets.acquire(GL_R32F, width, height, GL_NEAREST);
+    GLuint moments = render_targets.acquire(GL_RGBA32F, width, height, GL_NEAREST);
+    glNamedFramebufferTexture(moment_fb, GL_COLOR_ATTACHMENT0, opticalDepth, 0);
+    glNamedFramebufferTexture(moment_fb, GL_COLOR_ATTACHMENT1, moments, 0);
+    glNamedFramebufferTexture(moment_fb, GL_DEPTH_ATTACHMENT, render_targets.texture(oit_depth_target), 0);
+
+    glm::vec4 zero(0.);
+    glBindFramebuffer(GL_FRAMEBUFFER, moment_fb);
+    glClearBufferfv(GL_COLOR, 0, glm::value_ptr(zero));
+    glClearBufferfv(GL_COLOR, 1, glm::value_ptr(zero));
+    glBlendFunci(0, GL_ONE, GL_ONE);
+    glBlendFunci(1, GL_ONE, GL_ONE);
+    setTransparencyMode(TRANSPARENCY_MOMENT_GENERATION);
+    {
+        PROFILE_ZONE("moment generation traversal");
+        rootNode->render(SEMITRANSPARENT);
+    }
+
+    // only accumulation is written, revealage comes from the optical depth when compositing
+    glBindFramebuffer(GL_FRAMEBUFFER, semitransparent_pass_fb);
+    GLenum resolve_bufs[3] = {GL_NONE, GL_COLOR_ATTACHMENT1, GL_NONE};
+    glDrawBuffers(3, resolve_bufs);
+    glBlendFunci(1, GL_ONE, GL_ONE);
+    glBindTextureUnit(MOMENT_OPTICAL_DEPTH_SAMPLER, opticalDepth);
+    glBindTextureUnit(MOMENT_SAMPLER, moments);
+    setTransparencyMode(TRANSPARENCY_MOMENT_RESOLVE);
+    {
+        PROFILE_ZONE("moment resolve traversal");
+        rootNode->render(SEMITRANSPARENT);
+    }
+    setTransparencyMode(TRANSPARENCY_WEIGHTED_BLENDED);
+
+    transparent_targets.accum = render_targets.texture(oit_accum_target);
+    transparent_targets.reveal = opticalDepth;
+    transparent_targets.moments = moments;
+}
+
+// Composits the multisampled oit targets sample by sample into resolve_fb
+void resolveMultisampled() {
+    PROFILE_FUNCTION();
+    glBindFramebuffer(GL_FRAMEBUFFER, resolve_fb);
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    glDisable(GL_BLEND);
+    msaa_resolve_shader->activate();
+    glUniform1i(UNIFORM_SAMPLE_COUNT_LOC, render_targets.samples(oit_color_target));
+    glBindTextureUnit(ACCUMULATION_SAMPLER, render_targets.texture(oit_accum_target));
+    glBindTextureUnit(REVEALAGE_SAMPLER, render_targets.texture(oit_reveal_target));
+    glBindTextureUnit(MSAA_COLOR_SAMPLER, render_targets.texture(oit_color_target));
+    glBindVertexArray(compositeNode->vaoID);
+    glDrawElements(GL_TRIANGLES, compositeNode->vaoIndicesSize, GL_UNSIGNED_INT, nullptr);
+    draw_stats.count();
+    glEnable(GL_BLEND);
+}
+
+// Submits the pooled opaque draws collected during the OPAQUE traversal.
+// With the pre-pass, every fragment that survives GL_EQUAL is visible, so phong runs once per pixel.
+void drawOpaqueBatch() {
+    PROFILE_FUNCTION();
+    opaque_batch.upload(frame_pacer.slot());
+    mesh_pool.bind();
+    auto solid = [](const BatchMaterial &material) { return !material.alpha_tested; };
+    auto alphaTested = [](const BatchMaterial &material) { return material.alpha_tested; };
+
+    if (render_settings.depth_prepass) {
+        depth_prepass_shader->activate();
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        opaque_batch.draw(render_settings.multi_draw_indirect, draw_data, nullptr, solid);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    }
+    opaque_batched_shader->activate();
+    opaque_batch.draw(render_settings.multi_draw_indirect, draw_data, nullptr, solid);
+    glDepthFunc(GL_LEQUAL);
+    glDepthMask(GL_TRUE);
+
+    // discard would disable early-z for everything above, so holes get their own program
+    opaque_alphatest_shader->activate();
+    opaque_batch.draw(render_settings.multi_draw_indirect, draw_data, nullptr, alphaTested);
+}
+
 void renderFrame(GLFWwindow* window) {
-    int windowWidth, windowHeight;
-    glfwGetWindowSize(window, &windowWidth, &windowHeight);
-    glViewport(0, 0, windowWidth, windowHeight);
+    PROFILE_FUNCTION();
+    updateResolutionScale();
+    apply_oit_formats();
+
+    // render at the size the targets were last allocated for, which may be below the framebuffer size
+    int width = render_targets.width();
+    int height = render_targets.height();
+    if (width == 0 || height == 0) {
+        frame_pacer.endFrame();
+        return;
+    }
+    frame_data_ring.bind(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, frame_pacer.slot());
+    material_table.bind();
+    frame_timer.begin();
+    gpu_profiler.enabled = render_settings.gpu_profiling;
+    gpu_profiler.beginFrame();
+    glViewport(0, 0, width, height);
+
+    gpu_profiler.push("culling");
+    cullScene();
+    occlusionCull();
+    gpu_profiler.pop();
+    if (hot_reloader.poll()) registerSceneMaterials();
+    updateTextureResidency();
 
     // clear fb
+    gpu_profiler.push("clear");
     glBindFramebuffer(GL_FRAMEBUFFER, semitransparent_pass_fb);
 
     GLenum bufs[3] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
@@ -734,54 +1314,180 @@ void renderFrame(GLFWwindow* window) {
     glClearBufferfv(GL_COLOR, 2, glm::value_ptr(reveal_clear));
 
     glClear(GL_DEPTH_BUFFER_BIT);
+    gpu_profiler.pop();
 
     // draw the base opaque scene, write depth, use depth
+    gpu_profiler.push("opaque");
     glBlendFunci(0, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LEQUAL);
     glDepthMask(GL_TRUE);
     glDrawBuffer(GL_COLOR_ATTACHMENT0);
-    rootNode->render(OPAQUE);
+    opaque_batch.clear();
+    coverage_shells.clear();
+    buildDrawPackets();
+    {
+        PROFILE_ZONE("opaque traversal");
+        rootNode->render(OPAQUE);
+    }
+    drawOpaqueBatch();
+
+    // alpha to coverage shells write depth like any opaque surface, the fins still blend later
+    if (!coverage_shells.empty()) {
+        glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+        glDisable(GL_BLEND);
+        for (auto furred : coverage_shells) furred->drawShells(true);
+        glEnable(GL_BLEND);
+        glDisable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+    }
+    gpu_profiler.pop();
 
-    // draw blended transparent objects
-    // Have the base color of objects filter the colors behind them
-    glBlendFunci(0, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
-    // accumulated blended lit color, blend weighting happens in shader
-    glBlendFunci(1, GL_ONE, GL_ONE);
-    // remaining transparency of blend,
-    // white stencil slowly subtracted black where opaque background becomes hid
-    glBlendFunci(2, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
-    // transparent things do not occlude, so do not write to depth
-    glDepthMask(GL_FALSE);
+    // sky fills whatever the opaque pass left at the cleared far depth
+    gpu_profiler.push("skybox");
+    skyBoxNode->render(OPAQUE);
+    gpu_profiler.pop();
 
-    glDrawBuffers(3, bufs);
-    rootNode->render(SEMITRANSPARENT);
+    gpu_profiler.push("transparent");
+
+    // one depth sample per pixel for the occlusion pyramid and the transparent downsample
+    if (multisampled()) {
+        glBlitNamedFramebuffer(semitransparent_pass_fb, resolve_fb,
+                               0, 0, width, height, 0, 0, width, height,
+                               GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    }
+
+    int downsample = render_settings.transparency_downsample;
+    bool momentBased = render_settings.transparency_backend == TransparencyBackend::MOMENT_BASED;
+    if (momentBased && (multisampled() || downsample > 1)) {
+        static bool warned = false;
+        if (!warned) std::cerr << "Moment based transparency needs full resolution without msaa, using weighted blended" << std::endl;
+        warned = true;
+        momentBased = false;
+    }
+    transparent_targets.moment_based = momentBased;
+    // a lower resolution transparent pass gets its own targets, tested against a downsampled copy of the depth
+    transparent_targets.lowres = !momentBased && downsample > 1;
+    if (momentBased) {
+        // transparent things do not occlude, so do not write to depth
+        glDepthMask(GL_FALSE);
+        drawMomentTransparency(width, height);
+    } else if (transparent_targets.lowres) {
+        int lowWidth = std::max(1, width / downsample);
+        int lowHeight = std::max(1, height / downsample);
+        OitFormatSet formats = oitFormats(render_settings.oit_formats);
+        transparent_targets.modulation = render_targets.acquire(formats.color, lowWidth, lowHeight);
+        transparent_targets.accum = render_targets.acquire(formats.accumulation, lowWidth, lowHeight);
+        transparent_targets.reveal = render_targets.acquire(formats.revealage, lowWidth, lowHeight);
+        transparent_targets.depth = render_targets.acquire(GL_DEPTH_COMPONENT32F, lowWidth, lowHeight, GL_NEAREST);
+        glNamedFramebufferTexture(lowres_transparent_fb, GL_COLOR_ATTACHMENT0, transparent_targets.modulation, 0);
+        glNamedFramebufferTexture(lowres_transparent_fb, GL_COLOR_ATTACHMENT1, transparent_targets.accum, 0);
+        glNamedFramebufferTexture(lowres_transparent_fb, GL_COLOR_ATTACHMENT2, transparent_targets.reveal, 0);
+        glNamedFramebufferTexture(lowres_transparent_fb, GL_DEPTH_ATTACHMENT, transparent_targets.depth, 0);
+
+        // a multisampled source can not be scaled by a blit, so downsample the resolved depth
+        glBlitNamedFramebuffer(multisampled() ? resolve_fb : semitransparent_pass_fb, lowres_transparent_fb,
+                               0, 0, width, height, 0, 0, lowWidth, lowHeight,
+                               GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, lowres_transparent_fb);
+        glViewport(0, 0, lowWidth, lowHeight);
+        glClearBufferfv(GL_COLOR, 0, glm::value_ptr(color_clear));
+        glClearBufferfv(GL_COLOR, 1, glm::value_ptr(accum_clear));
+        glClearBufferfv(GL_COLOR, 2, glm::value_ptr(reveal_clear));
+    } else {
+        transparent_targets.accum = render_targets.texture(oit_accum_target);
+        transparent_targets.reveal = render_targets.texture(oit_reveal_target);
+    }
+
+    if (!momentBased) {
+        // draw blended transparent objects
+        // Have the base color of objects filter the colors behind them
+        glBlendFunci(0, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+        // accumulated blended lit color, blend weighting happens in shader
+        glBlendFunci(1, GL_ONE, GL_ONE);
+        // remaining transparency of blend,
+        // white stencil slowly subtracted black where opaque background becomes hid
+        glBlendFunci(2, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+        // transparent things do not occlude, so do not write to depth
+        glDepthMask(GL_FALSE);
+
+        // the lean layout drops the modulation output, so every fur fragment blends into two attachments instead of three
+        GLenum lean_bufs[3] = {GL_NONE, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+        glDrawBuffers(3, render_settings.lean_oit ? lean_bufs : bufs);
+        PROFILE_ZONE("transparent traversal");
+        rootNode->render(SEMITRANSPARENT);
+    }
+    gpu_profiler.pop();
 
 
     // composite transparent onto opaque
-    // This just composits buffers, so depth is irrelevant
+    gpu_profiler.push("composite");
+    // This just composits buffers, so depth is irrelevant.
+    // Depth testing is off rather than GL_ALWAYS so the quad does not overwrite the scene depth,
+    // the next frame's occlusion pyramid is built from it.
     glDepthMask(GL_TRUE);
-    glDepthFunc(GL_ALWAYS);
-
-    // use other layers as textures
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, oit_accum_tex);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, oit_reveal_tex);
-    // compose them on top of opaque color
-    glDrawBuffer(GL_COLOR_ATTACHMENT0);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    compositeNode->render(OPAQUE);
+    glDisable(GL_DEPTH_TEST);
+
+    // compose the other layers on top of opaque color
+    if (transparent_targets.lowres) {
+        glBindFramebuffer(GL_FRAMEBUFFER, semitransparent_pass_fb);
+        glViewport(0, 0, width, height);
+        // the opaque color was not modulated yet, the second output carries modulation times revealage
+        glDrawBuffer(GL_COLOR_ATTACHMENT0);
+        glBlendFunc(GL_ONE, GL_SRC1_COLOR);
+        compositeNode->render(OPAQUE);
+        render_targets.release(transparent_targets.modulation);
+        render_targets.release(transparent_targets.accum);
+        render_targets.release(transparent_targets.reveal);
+        render_targets.release(transparent_targets.depth);
+    } else if (!multisampled()) {
+        glDrawBuffer(GL_COLOR_ATTACHMENT0);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        compositeNode->render(OPAQUE);
+        if (momentBased) {
+            render_targets.release(transparent_targets.reveal);
+            render_targets.release(transparent_targets.moments);
+        }
+    }
+    // the multisampled accumulation is composited per sample while resolving,
+    // after a low resolution composite it is still clear and only the color resolves
+    if (multisampled()) resolveMultisampled();
+    gpu_profiler.pop();
 
 
     // copy onto screen
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, semitransparent_pass_fb);
+    gpu_profiler.push("blit");
+    glBindFramebuffer(GL_FRAMEBUFFER, output_framebuffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, multisampled() ? resolve_fb : semitransparent_pass_fb);
     glReadBuffer(GL_COLOR_ATTACHMENT0);
-    glBlitFramebuffer(0,0,DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT,
-                      0,0,DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT,
-                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    // filtered upscale when dynamic resolution has lowered the render size
+    int outputWidth = render_targets.outputWidth();
+    int outputHeight = render_targets.outputHeight();
+    GLenum filter = width == outputWidth && height == outputHeight ? GL_NEAREST : GL_LINEAR;
+    glBlitFramebuffer(0,0,width, height,
+                      0,0,outputWidth, outputHeight,
+                      GL_COLOR_BUFFER_BIT, filter);
+    gpu_profiler.pop();
+    gpu_profiler.endFrame();
+    frame_timer.end();
+    frame_pacer.endFrame();
+
+    if (render_settings.gpu_profiling && glfwGetTime() - last_profile_report > render_settings.profile_report_seconds) {
+        last_profile_report = glfwGetTime();
+        std::cout << "GPU frame profile:" << std::endl;
+        gpu_profiler.report(std::cout);
+    }
+    if (render_settings.frame_stats && glfwGetTime() - last_pacing_report > render_settings.profile_report_seconds) {
+        last_pacing_report = glfwGetTime();
+        std::cout << "Frame pacing: ";
+        frame_pacer.report(std::cout);
+        std::cout << "GPU memory: ";
+        texture_residency.report(std::cout);
+    }
 
     // add UI
 //    rootNode->render(UI);
+
+    // this frame's depth is what the next frame's occlusion test sees
+    previous_VP = VP;
+    has_previous_depth = true;
 }
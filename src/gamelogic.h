@@ -1,8 +1,33 @@
 #pragma once
 
 #include "scenegraph.hpp"
+#include "utilities/camerapath.hpp"
+#include "utilities/gpuprofiler.hpp"
+#include "utilities/framepacer.hpp"
+#include "utilities/residency.hpp"
+
+// per stage gpu timings of the frames renderFrame draws
+extern GpuProfiler gpu_profiler;
+// frames in flight, updateFrame begins a frame and renderFrame ends it
+extern FramePacer frame_pacer;
+// textures of every material in the scene, uploaded by initialize_game
+extern MaterialTable material_table;
+// gpu memory and the resolution of streamed textures
+extern ResidencyManager texture_residency;
 
 void updateNodeTransformations(SceneNode* node, glm::mat4 transformationThusFar);
 void initialize_game(GLFWwindow* window);
 void updateFrame(GLFWwindow* window);
-void renderFrame(GLFWwindow* window);
\ No newline at end of file
+void renderFrame(GLFWwindow* window);
+// 0 goes back to wall clock time
+void setFixedTimestep(double seconds);
+// the camera follows path instead of the keyboard, nullptr to give control back
+void setCameraPath(const CameraPath *path);
+// renderFrame blits its output into framebuffer, 0 is the window
+void setOutputFramebuffer(GLuint framebuffer);
+// registers every material of the drawn geometry again, after cached textures got new ids
+void registerSceneMaterials();
+// rebuilds shaders and reloads textures whose files change from then on, renderFrame applies them
+void startHotReload(GLFWwindow* window);
+// before the window's context goes away
+void stopHotReload();
\ No newline at end of file
@@ -4,12 +4,14 @@
 
 #include "window.hpp"
 #include "game.hpp"
+#include "benchmark.hpp"
+#include "utilities/eglcontext.hpp"
 
 static void glfwErrorCallback(int error, const char *description){
     std::cerr << "GLFW err: " << error << std::endl << description << std::endl << std::endl;
 }
 
-GLFWwindow* initialize_window(){
+GLFWwindow* initialize_window(int width, int height, bool visible){
     if (!glfwInit()) {
         const char *err;
         glfwGetError(&err);
@@ -22,9 +24,11 @@ GLFWwindow* initialize_window(){
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    glfwWindowHint(GLFW_RESIZABLE, true);
+    glfwWindowHint(GLFW_RESIZABLE, visible);
+    // benchmarks render offscreen into the default framebuffer of a hidden window
+    glfwWindowHint(GLFW_VISIBLE, visible);
 
-    auto window = glfwCreateWindow(DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT, DEFAULT_WINDOW_NAME.c_str(), nullptr, nullptr);
+    auto window = glfwCreateWindow(width, height, DEFAULT_WINDOW_NAME.c_str(), nullptr, nullptr);
 
     glfwMakeContextCurrent(window);
     gladLoadGL();
@@ -36,15 +40,53 @@ GLFWwindow* initialize_window(){
     return window;
 }
 
+// A surfaceless EGL context does the rendering, GLFW only supplies a null window for input, size and time.
+// Needs GLFW 3.4 for the null platform, older versions still open a display for the window.
+GLFWwindow* initialize_headless_window(int width, int height){
+#ifdef GLFW_PLATFORM_NULL
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+    glfwSetErrorCallback(glfwErrorCallback);
+    if (!glfwInit()) return nullptr;
 
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    glfwWindowHint(GLFW_VISIBLE, false);
+    auto window = glfwCreateWindow(width, height, DEFAULT_WINDOW_NAME.c_str(), nullptr, nullptr);
+    if (!window || !createSurfacelessContext(4, 3)) {
+        glfwTerminate();
+#ifdef GLFW_PLATFORM_NULL
+        glfwInitHint(GLFW_PLATFORM, GLFW_ANY_PLATFORM);
+#endif
+        glfwDefaultWindowHints();
+        return nullptr;
+    }
+    gladLoadGLLoader(surfacelessProcAddress);
+    return window;
+}
 
-int main()
+int main(int argc, char **argv)
 {
-    GLFWwindow* window = initialize_window();
-    run_game(window);
+    BenchmarkOptions benchmark;
+    if (!parseBenchmarkArguments(argc, argv, benchmark)) return EXIT_FAILURE;
+
+    int result = EXIT_SUCCESS;
+    if (benchmark.enabled) {
+        GLFWwindow* window = nullptr;
+        if (benchmark.headless) {
+            window = initialize_headless_window(benchmark.width, benchmark.height);
+            if (!window) std::cerr << "No surfaceless context, rendering in a hidden window instead" << std::endl;
+            benchmark.headless = window != nullptr;
+        }
+        if (!window) window = initialize_window(benchmark.width, benchmark.height, false);
+        if (!run_benchmark(window, benchmark)) result = EXIT_FAILURE;
+        if (benchmark.headless) destroySurfacelessContext();
+    } else {
+        GLFWwindow* window = initialize_window(DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT, true);
+        run_game(window);
+    }
 
     // Terminate GLFW (no need to call glfwDestroyWindow)
     // todo gldeleteframebuffers?
     glfwTerminate();
-    return EXIT_SUCCESS;
+    return result;
 }
@@ -0,0 +1,42 @@
+#include "render_settings.hpp"
+
+void applyQualityLevel(RenderSettings &settings, QualityLevel level) {
+    switch (level) {
+        case QualityLevel::LOW:
+            settings.transparency_backend = TransparencyBackend::WEIGHTED_BLENDED;
+            settings.transparency_downsample = 2;
+            settings.oit_formats = OitFormats::COMPACT;
+            settings.lean_oit = true;
+            settings.msaa_samples = 1;
+            settings.alpha_to_coverage_shells = false;
+            settings.gpu_memory_budget_mb = 128;
+            break;
+        case QualityLevel::MEDIUM:
+            settings.transparency_backend = TransparencyBackend::WEIGHTED_BLENDED;
+            settings.transparency_downsample = 1;
+            settings.oit_formats = OitFormats::BALANCED;
+            settings.lean_oit = false;
+            settings.msaa_samples = 1;
+            settings.alpha_to_coverage_shells = false;
+            settings.gpu_memory_budget_mb = 256;
+            break;
+        case QualityLevel::HIGH:
+            // correct layering of deep fur stacks, the moment passes run at full resolution without msaa
+            settings.transparency_backend = TransparencyBackend::MOMENT_BASED;
+            settings.transparency_downsample = 1;
+            settings.oit_formats = OitFormats::BALANCED;
+            settings.lean_oit = false;
+            settings.msaa_samples = 1;
+            settings.alpha_to_coverage_shells = false;
+            settings.gpu_memory_budget_mb = 512;
+            break;
+    }
+}
+
+bool parseQualityLevel(const std::string &name, QualityLevel &level) {
+    if (name == "low") level = QualityLevel::LOW;
+    else if (name == "medium") level = QualityLevel::MEDIUM;
+    else if (name == "high") level = QualityLevel::HIGH;
+    else return false;
+    return true;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+
+// Attachment formats of the opaque color, accumulation and revealage targets
+enum class OitFormats {
+    PRECISE,  // RGBA32F color, RGBA16F accumulation, R16F revealage
+    BALANCED, // RGBA16F color, RGBA16F accumulation, R16F revealage
+    COMPACT,  // R11F_G11F_B10F color, RGBA16F accumulation, R8 revealage
+};
+
+// How the SEMITRANSPARENT pass resolves overlapping surfaces
+enum class TransparencyBackend {
+    // one pass, depth based weights approximate the order
+    WEIGHTED_BLENDED,
+    // a pass summing power moments of depth, then a pass weighting each fragment by what lies in front of it
+    MOMENT_BASED,
+};
+
+// Presets for the settings below
+enum class QualityLevel {
+    LOW,
+    MEDIUM,
+    HIGH,
+};
+
+// Renderer toggles, the one instance lives in gamelogic.cpp
+struct RenderSettings {
+    // submit the pooled opaque geometry with glMultiDrawElementsIndirect, one call for the solid and one for
+    // the alpha tested materials, shaders find each draw's material through the DrawData
+    bool multi_draw_indirect = true;
+    // test pooled draws outside the opaque batch against a depth pyramid of the previous frame
+    bool occlusion_culling = true;
+    // lay down opaque depth with a position-only shader first, then shade with GL_EQUAL
+    bool depth_prepass = true;
+    // lower the render resolution when the gpu frame time goes over target_frame_ms, the blit upscales
+    bool dynamic_resolution = true;
+    float target_frame_ms = 16.6f;
+    float min_resolution_scale = 0.5f;
+    float max_resolution_scale = 1.0f;
+    // 1 renders the SEMITRANSPARENT pass at full resolution, 2 at half and 4 at quarter, upsampled by depth
+    int transparency_downsample = 1;
+    OitFormats oit_formats = OitFormats::BALANCED;
+    // transparent surfaces only blend into accumulation and revealage, they no longer tint what is behind them
+    bool lean_oit = false;
+    // samples per pixel of the oit targets, resolved sample by sample before the blit
+    int msaa_samples = 1;
+    // with msaa, draw fur shells in the opaque pass with alpha to coverage instead of blending them
+    bool alpha_to_coverage_shells = false;
+    // moment based needs full resolution single sample targets, it falls back to weighted blended otherwise
+    TransparencyBackend transparency_backend = TransparencyBackend::WEIGHTED_BLENDED;
+    // time the render stages with gpu timestamps and print averages and percentiles every few seconds
+    bool gpu_profiling = false;
+    // also time the shells and fins of every furred node on its own
+    bool profile_nodes = false;
+    float profile_report_seconds = 5.f;
+    // frames the cpu may prepare before the gpu has finished the oldest, 1 to 3, 1 waits for every frame
+    int frames_in_flight = 2;
+    // passed to glfwSwapInterval, 0 presents right away, 1 waits for vsync
+    int swap_interval = 1;
+    // frames per second to pace the loop to when not waiting for vsync, 0 for as fast as possible
+    float frame_rate_limit = 0;
+    // print frame rate, fence waits and latency every profile_report_seconds
+    bool frame_stats = false;
+    // threads for the scene update, culling and draw packets, main thread included.
+    // Read once by initialize_game, 0 uses every core and 1 keeps all of it on the main thread
+    int job_threads = 0;
+    // material textures as resident GL_ARB_bindless_texture handles, otherwise they are copied into texture arrays.
+    // Read once by initialize_game, the arrays are also used without GL_ARB_bindless_texture and GL_NV_gpu_shader5
+    bool bindless_textures = true;
+    // material maps start small and the residency manager grows them to the size they are drawn at.
+    // Read once by initialize_game, off loads every texture in full
+    bool texture_streaming = true;
+    // what textures, render targets and the big buffers are kept under by dropping texture mips, 0 for no limit
+    float gpu_memory_budget_mb = 256;
+    // texels streaming asks for per pixel an object spans, above 1 for surfaces that tile their textures
+    float texture_detail = 1.f;
+    // rebuild shaders and reload textures when their files under res change. Read once by run_game
+    bool hot_reload = true;
+};
+
+extern RenderSettings render_settings;
+
+void applyQualityLevel(RenderSettings &settings, QualityLevel level);
+// "low", "medium" or "high", false for anything else
+bool parseQualityLevel(const std::string &name, QualityLevel &level);
@@ -21,10 +21,14 @@ int totalChildren(SceneNode* parent) {
 }
 
 
-Geometry::Geometry(const std::string &objname) : SceneNode() {
-    Mesh m("../res/models/" + objname + ".obj");
-    unsigned int terrainVAO = generateBuffer(m);
-    vaoID = terrainVAO;
-    vaoIndicesSize = m.indices.size();
+Geometry::Geometry(const std::string &objname) : SceneNode(), name(objname) {
+    setMesh(resource_cache.mesh("../res/models/" + objname + ".obj"));
+}
+
+void Geometry::setMesh(MeshHandle mesh) {
+    meshRange = mesh->range;
+    pooled = true;
+    vaoIndicesSize = meshRange.indexCount;
+    this->mesh = std::move(mesh);
+}
 
-}
\ No newline at end of file
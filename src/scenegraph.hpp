@@ -5,6 +5,10 @@
 #include <vector>
 #include <glad/glad.h>
 #include <string>
+#include "utilities/drawbatch.hpp"
+#include "utilities/materialtable.hpp"
+#include "utilities/meshpool.hpp"
+#include "utilities/resourcecache.hpp"
 
 enum render_type {
     OPAQUE = 0,
@@ -22,6 +26,7 @@ public:
         referencePoint = glm::vec3(0, 0, 0);
 
 	}
+	virtual ~SceneNode() = default;
 
 	// A list of all children that belong to this node.
 	// For instance, in case of the scene graph of a human body shown in the assignment text, the "Upper Torso" node would contain the "Left Arm", "Right Arm", "Head" and "Lower Torso" nodes in its list of children.
@@ -40,29 +45,82 @@ public:
 
     render_type render_pass = OPAQUE;
 
+    // nodes in this subtree, itself included, big subtrees are updated as jobs
+    int subtreeSize = 1;
 
     virtual void render(render_type pass);
 
     virtual void update(glm::mat4 transformationThusFar);
 };
 
+// the MaterialTable entries a Geometry draws with, in the order of DrawData::materials
+enum GeometryMaterial {
+    SURFACE_MATERIAL,
+    SHELL_MATERIAL,
+    FIN_MATERIAL,
+    GEOMETRY_MATERIALS
+};
+
 class Geometry : public SceneNode {
 public:
-    GLuint textureID = 0;
+    // what unmaterialed nodes like the skybox and text bind, read its id through textureName
+    TextureHandle texture;
     int vaoID = -1;
     GLsizei vaoIndicesSize = 0;
+    // the model it was loaded from, empty for generated meshes
+    std::string name;
+    // meshes in the shared mesh_pool use meshRange instead of vaoID
+    bool pooled = false;
+    MeshRange meshRange;
     Geometry() : SceneNode() {}
     explicit Geometry(const std::string &objname);
+    // draws a cached pooled mesh, shared with every other node using it
+    void setMesh(MeshHandle mesh);
     void render(render_type pass) override;
+
+    // world-space bounds of pooled meshes, refreshed every update
+    AABB worldBounds;
+    BoundingSphere worldSphere;
+    // item in the scene BVH, -1 if never culled
+    int cullingID = -1;
+    // entry in this frame's DrawDataBuffer, -1 if it is not part of the scene graph
+    int drawID = -1;
+    // result of this frame's frustum test
+    bool visible = true;
+    // how many pixels the world sphere spans on screen when visible, what texture streaming goes by
+    float screenSize = 0;
+
+    void update(glm::mat4 transformationThusFar) override;
+    // how far rendering may reach outside the mesh, in model space
+    virtual float boundsPadding() const { return 0; }
+
+    // cached mesh this node draws with, released along with it
+    MeshHandle mesh;
+
+    // the untextured default unless registerMaterials fills them in
+    GLuint materials[GEOMETRY_MATERIALS] = {};
+    virtual void registerMaterials(MaterialTable &table) {}
+    // what the opaque batch groups this by, when it is pooled
+    virtual BatchMaterial batchMaterial() const { return BatchMaterial(); }
+
+    bool hasMesh() const { return pooled || vaoID != -1; }
+    // binds whichever vertex array holds the mesh and draws it
+    void drawMesh();
 };
 
 class TexturedGeometry : public Geometry {
 public:
-    GLuint roughnessID = 0;
-    GLuint normalMapID = 0;
+    // streamed maps change ids, registerMaterials reads them from here
+    TextureHandle colorMap;
+    TextureHandle normalMap;
+    TextureHandle roughnessMap;
     TexturedGeometry() : Geometry() {}
     explicit TexturedGeometry(const std::string &objname);
+    // <name>_col, _nrm and _rgh.png from res/textures, through the resource cache
+    void loadTextures(const std::string &name);
     void render(render_type pass) override;
+    void registerMaterials(MaterialTable &table) override;
+    BatchMaterial batchMaterial() const override;
 };
 
 class Skybox : public Geometry {
@@ -73,15 +131,21 @@ public:
 
 class FurredGeometry : public TexturedGeometry {
 public:
-    GLuint furID = 0;
-    GLuint furNormalMapID = 0;
-    GLuint strandTextureID = 0;
-    GLuint furTurbulenceID = 0;
+    TextureHandle furMap;
+    TextureHandle furNormalMap;
+    TextureHandle strandMap;
+    TextureHandle furTurbulenceMap;
     float strand_length = 2.5;
     render_type render_pass = SEMITRANSPARENT;
     FurredGeometry() : TexturedGeometry() {}
     explicit FurredGeometry(const std::string &objname);
     void render(render_type pass) override;
+    void registerMaterials(MaterialTable &table) override;
+    // shells and fins stick out by up to the (fin) strand length
+    float boundsPadding() const override;
+    // coverage draws the alpha to coverage variant in the opaque pass
+    void drawShells(bool coverage);
+    void drawFins();
 };
 
 class FlatGeometry : public Geometry {
@@ -98,20 +162,16 @@ public:
     int lightID = 0;
     glm::vec3 lightColor = glm::vec3(0.6, 0.6, 0.6);
 
+    // writes the world position and color into this frame's light array
+    void update(glm::mat4 transformationThusFar) override;
 };
 class CompositorNode : public Geometry {
 public:
     void render(render_type pass) override;
 };
 
-class PointLight : public LightNode {
-public:
-    void update(glm::mat4 transformationThusFar) override;
-};
-class DirLight : public LightNode {
-public:
-    void update(glm::mat4 transformationThusFar) override;
-};
+class PointLight : public LightNode {};
+class DirLight : public LightNode {};
 
 SceneNode* createSceneNode();
 void addChild(SceneNode* parent, SceneNode* child);
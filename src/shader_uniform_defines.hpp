@@ -1,29 +1,53 @@
 #pragma once
 
 // This is the master list of hard uniform locations and names, shaders should comply.
-#define UNIFORM_NORMAL_MATRIX_LOC 1
-#define UNIFORM_CAMPOS_LOC 2
 #define UNIFORM_MVP_LOC 3
-#define UNIFORM_MODEL_LOC 4
 #define UNIFORM_BALLPOS_LOC 5
-#define UNIFORM_ENABLE_NMAP_LOC 6
-#define UNIFORM_FUR_LENGTH_LOC 8
-#define UNIFORM_WIND_LOC 7
-
-#define UNIFORM_POINT_LIGHT_SOURCES_NAME "point_light_sources"
-#define UNIFORM_POINT_LIGHT_SOURCES_POSITION_NAME "position"
-#define UNIFORM_POINT_LIGHT_SOURCES_COLOR_NAME "color"
+#define UNIFORM_TRANSPARENCY_MODE_LOC 9
+#define UNIFORM_LOG_DEPTH_RANGE_LOC 10
 
+// camera, wind and lights, the FrameData uniform block
+#define FRAME_DATA_BINDING 0
 #define UNIFORM_POINT_LIGHT_SOURCES_LEN 4
 
 #define TEX_TEXT_SAMPLER 0
-#define SIMPLE_TEXTURE_SAMPLER 0
-#define SIMPLE_NORMAL_SAMPLER 1
-#define SIMPLE_ROUGHNESS_SAMPLER 2
-#define FUR_FUR_SAMPLER 3
-#define FUR_TURBULENCE_SAMPLER 4
 
 #define ACCUMULATION_SAMPLER 0
 #define REVEALAGE_SAMPLER 1
+#define MODULATION_SAMPLER 2
+#define LOWRES_DEPTH_SAMPLER 3
+#define SCENE_DEPTH_SAMPLER 4
+#define MSAA_COLOR_SAMPLER 2
+#define UNIFORM_SAMPLE_COUNT_LOC 0
+
+// transparency_mode values of moment_oit.frag
+#define TRANSPARENCY_WEIGHTED_BLENDED 0
+#define TRANSPARENCY_MOMENT_GENERATION 1
+#define TRANSPARENCY_MOMENT_RESOLVE 2
+#define MOMENT_OPTICAL_DEPTH_SAMPLER 6
+#define MOMENT_SAMPLER 7
+
+#define SKYBOX_CUBE_SAMPLER 0
+
+// DrawData of the drawn objects, a storage buffer
+#define DRAW_DATA_BINDING 0
+
+// MaterialData of every material, a storage buffer, and the texture arrays used without bindless textures
+#define MATERIAL_BINDING 3
+#define MATERIAL_ARRAY_SAMPLER 8
+// MaterialData::flags, material.glsl
+#define MATERIAL_FLAG_TEXTURED 1
+// shifted left by the slot, the slot holds a color instead of a texture
+#define MATERIAL_FLAG_CONSTANT_SLOT 256
+
+// hi-z occlusion culling compute shaders
+#define UNIFORM_HIZ_SOURCE_LEVEL_LOC 0
+#define UNIFORM_HIZ_COPY_LOC 1
+#define UNIFORM_HIZ_VP_LOC 0
+#define UNIFORM_HIZ_OBJECT_COUNT_LOC 4
+#define UNIFORM_HIZ_USE_PYRAMID_LOC 5
 
-#define SKYBOX_CUBE_SAMPLER 0
\ No newline at end of file
+#define HIZ_SOURCE_SAMPLER 0
+#define HIZ_DESTINATION_IMAGE 0
+#define HIZ_OBJECT_BINDING 1
+#define HIZ_COMMAND_BINDING 2
@@ -0,0 +1,117 @@
+#include "bounds.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+float AABB::surfaceArea() const {
+    if (empty()) return 0;
+    glm::vec3 e = extent();
+    return 2 * (e.x * e.y + e.y * e.z + e.z * e.x);
+}
+
+void AABB::expand(const glm::vec3 &point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+void AABB::expand(const AABB &other) {
+    if (other.empty()) return;
+    expand(other.min);
+    expand(other.max);
+}
+
+AABB AABB::inflated(float amount) const {
+    AABB box = *this;
+    if (!empty()) {
+        box.min -= glm::vec3(amount);
+        box.max += glm::vec3(amount);
+    }
+    return box;
+}
+
+AABB computeBounds(const std::vector<glm::vec3> &points) {
+    AABB box;
+    for (const auto &point : points) box.expand(point);
+    return box;
+}
+
+BoundingSphere computeBoundingSphere(const AABB &box, const std::vector<glm::vec3> &points) {
+    BoundingSphere sphere;
+    if (box.empty()) return sphere;
+    // centered on the box, tighter than the box's own circumsphere
+    sphere.center = box.center();
+    float radius2 = 0;
+    for (const auto &point : points) {
+        glm::vec3 d = point - sphere.center;
+        radius2 = std::max(radius2, glm::dot(d, d));
+    }
+    sphere.radius = std::sqrt(radius2);
+    return sphere;
+}
+
+AABB transformAABB(const AABB &box, const glm::mat4 &transform) {
+    if (box.empty()) return box;
+    // Arvo's method, transform the center and the absolute half extents
+    glm::vec3 center = glm::vec3(transform * glm::vec4(box.center(), 1));
+    glm::vec3 half = box.extent() * 0.5f;
+    glm::vec3 newHalf(0);
+    for (int col = 0; col < 3; ++col) {
+        newHalf += glm::abs(glm::vec3(transform[col])) * half[col];
+    }
+    AABB result;
+    result.min = center - newHalf;
+    result.max = center + newHalf;
+    return result;
+}
+
+BoundingSphere transformSphere(const BoundingSphere &sphere, const glm::mat4 &transform) {
+    BoundingSphere result;
+    if (sphere.radius < 0) return result;
+    result.center = glm::vec3(transform * glm::vec4(sphere.center, 1));
+    float scale = std::max({glm::length(glm::vec3(transform[0])),
+                            glm::length(glm::vec3(transform[1])),
+                            glm::length(glm::vec3(transform[2]))});
+    result.radius = sphere.radius * scale;
+    return result;
+}
+
+Frustum extractFrustum(const glm::mat4 &VP) {
+    // glm is column major, so row i is VP[0][i], VP[1][i], ...
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; ++i) {
+        rows[i] = glm::vec4(VP[0][i], VP[1][i], VP[2][i], VP[3][i]);
+    }
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0]; // left
+    frustum.planes[1] = rows[3] - rows[0]; // right
+    frustum.planes[2] = rows[3] + rows[1]; // bottom
+    frustum.planes[3] = rows[3] - rows[1]; // top
+    frustum.planes[4] = rows[3] + rows[2]; // near
+    frustum.planes[5] = rows[3] - rows[2]; // far
+    for (auto &plane : frustum.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+bool intersects(const Frustum &frustum, const AABB &box) {
+    if (box.empty()) return false;
+    for (const auto &plane : frustum.planes) {
+        // the corner furthest along the plane normal
+        glm::vec3 positive(
+            plane.x >= 0 ? box.max.x : box.min.x,
+            plane.y >= 0 ? box.max.y : box.min.y,
+            plane.z >= 0 ? box.max.z : box.min.z
+        );
+        if (glm::dot(glm::vec3(plane), positive) + plane.w < 0) return false;
+    }
+    return true;
+}
+
+bool intersects(const Frustum &frustum, const BoundingSphere &sphere) {
+    if (sphere.radius < 0) return false;
+    for (const auto &plane : frustum.planes) {
+        if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius) return false;
+    }
+    return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// Axis aligned bounding box, empty when min > max
+struct AABB {
+    glm::vec3 min = glm::vec3(1e30f);
+    glm::vec3 max = glm::vec3(-1e30f);
+
+    bool empty() const { return min.x > max.x; }
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extent() const { return max - min; }
+    float surfaceArea() const;
+    void expand(const glm::vec3 &point);
+    void expand(const AABB &other);
+    AABB inflated(float amount) const;
+};
+
+struct BoundingSphere {
+    glm::vec3 center = glm::vec3(0);
+    float radius = -1;
+};
+
+// Planes point inwards, a point p is inside plane n when dot(n.xyz, p) + n.w >= 0
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+AABB computeBounds(const std::vector<glm::vec3> &points);
+BoundingSphere computeBoundingSphere(const AABB &box, const std::vector<glm::vec3> &points);
+
+AABB transformAABB(const AABB &box, const glm::mat4 &transform);
+BoundingSphere transformSphere(const BoundingSphere &sphere, const glm::mat4 &transform);
+
+// Gribb-Hartmann plane extraction from a view-projection matrix
+Frustum extractFrustum(const glm::mat4 &VP);
+bool intersects(const Frustum &frustum, const AABB &box);
+bool intersects(const Frustum &frustum, const BoundingSphere &sphere);
@@ -0,0 +1,130 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+
+const int MAX_LEAF_ITEMS = 4;
+// rebuild once refitting has made the root this much bigger than when it was built
+const float REBUILD_AREA_RATIO = 2;
+
+int BVH::insert(const AABB &box) {
+    itemBoxes.push_back(box);
+    structureDirty = true;
+    return itemBoxes.size() - 1;
+}
+
+void BVH::update(int item, const AABB &box) {
+    itemBoxes[item] = box;
+    boxesDirty = true;
+}
+
+void BVH::refit() {
+    if (structureDirty) {
+        rebuild();
+        return;
+    }
+    if (!boxesDirty) return;
+    boxesDirty = false;
+
+    // nodes are stored parent first, so walking backwards sees children before their parent
+    for (int i = int(nodes.size()) - 1; i >= 0; --i) {
+        Node &node = nodes[i];
+        node.box = AABB();
+        if (node.isLeaf()) {
+            for (int j = node.firstItem; j < node.firstItem + node.itemCount; ++j) {
+                node.box.expand(itemBoxes[order[j]]);
+            }
+        } else {
+            node.box.expand(nodes[node.left].box);
+            node.box.expand(nodes[node.right].box);
+        }
+    }
+    if (!nodes.empty() && nodes[0].box.surfaceArea() > REBUILD_AREA_RATIO * builtRootArea) {
+        rebuild();
+    }
+}
+
+void BVH::rebuild() {
+    structureDirty = false;
+    boxesDirty = false;
+    nodes.clear();
+    order.resize(itemBoxes.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    if (!order.empty()) build(0, order.size());
+    builtRootArea = nodes.empty() ? 0 : nodes[0].box.surfaceArea();
+}
+
+int BVH::build(int first, int count) {
+    int index = nodes.size();
+    nodes.emplace_back();
+
+    AABB box, centers;
+    for (int i = first; i < first + count; ++i) {
+        box.expand(itemBoxes[order[i]]);
+        centers.expand(itemBoxes[order[i]].center());
+    }
+    nodes[index].box = box;
+
+    if (count <= MAX_LEAF_ITEMS) {
+        nodes[index].firstItem = first;
+        nodes[index].itemCount = count;
+        return index;
+    }
+
+    // median split along the longest axis of the item centers
+    glm::vec3 extent = centers.extent();
+    int axis = 0;
+    if (extent.y > extent[axis]) axis = 1;
+    if (extent.z > extent[axis]) axis = 2;
+    int mid = first + count / 2;
+    std::nth_element(order.begin() + first, order.begin() + mid, order.begin() + first + count,
+                     [&](int a, int b) { return itemBoxes[a].center()[axis] < itemBoxes[b].center()[axis]; });
+
+    int left = build(first, mid - first);
+    int right = build(mid, first + count - mid);
+    nodes[index].left = left;
+    nodes[index].right = right;
+    return index;
+}
+
+void BVH::query(const Frustum &frustum, const std::function<void(int)> &visit) const {
+    if (nodes.empty()) return;
+    querySubtree(0, frustum, visit);
+}
+
+void BVH::query(const Frustum &frustum, const std::function<void(int)> &visit, JobSystem &jobs) const {
+    if (nodes.empty()) return;
+    // open the tree breadth first until there are a few subtrees per thread
+    std::vector<int> subtrees = {0};
+    size_t wanted = size_t(jobs.threadCount()) * 4;
+    for (size_t i = 0; i < subtrees.size() && subtrees.size() < wanted;) {
+        const Node &node = nodes[subtrees[i]];
+        if (node.isLeaf()) {
+            ++i;
+        } else if (!intersects(frustum, node.box)) {
+            subtrees.erase(subtrees.begin() + i);
+        } else {
+            subtrees[i] = node.left;
+            subtrees.push_back(node.right);
+        }
+    }
+    jobs.parallelFor(subtrees.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) querySubtree(subtrees[i], frustum, visit);
+    });
+}
+
+void BVH::querySubtree(int root, const Frustum &frustum, const std::function<void(int)> &visit) const {
+    std::vector<int> stack = {root};
+    while (!stack.empty()) {
+        const Node &node = nodes[stack.back()];
+        stack.pop_back();
+        if (!intersects(frustum, node.box)) continue;
+        if (node.isLeaf()) {
+            for (int i = node.firstItem; i < node.firstItem + node.itemCount; ++i) {
+                if (intersects(frustum, itemBoxes[order[i]])) visit(order[i]);
+            }
+        } else {
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+}
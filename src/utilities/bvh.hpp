@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <vector>
+#include "bounds.hpp"
+#include "jobsystem.hpp"
+
+// World-space bounding volume hierarchy over integer item ids.
+// Moving items only refit the boxes, the tree is rebuilt when items are added
+// or the refitted tree has grown too loose.
+class BVH {
+public:
+    int insert(const AABB &box);
+    // safe from several threads at once as long as they update different items
+    void update(int item, const AABB &box);
+    // bring the tree up to date with the inserts and updates since last call
+    void refit();
+    void rebuild();
+    // calls visit with every item whose box touches the frustum
+    void query(const Frustum &frustum, const std::function<void(int)> &visit) const;
+    // the same, with the subtrees below the top few levels as jobs, so visit is called from several threads
+    void query(const Frustum &frustum, const std::function<void(int)> &visit, JobSystem &jobs) const;
+
+    size_t size() const { return itemBoxes.size(); }
+    const AABB &bounds(int item) const { return itemBoxes[item]; }
+
+private:
+    struct Node {
+        AABB box;
+        int left = -1;
+        int right = -1;
+        int firstItem = 0;
+        int itemCount = 0;
+        bool isLeaf() const { return left < 0; }
+    };
+
+    int build(int first, int count);
+    void querySubtree(int root, const Frustum &frustum, const std::function<void(int)> &visit) const;
+
+    std::vector<Node> nodes;
+    std::vector<AABB> itemBoxes;
+    std::vector<int> order; // item ids, leaves own contiguous ranges of this
+    bool structureDirty = false;
+    std::atomic<bool> boxesDirty{false};
+    float builtRootArea = 0;
+};
@@ -0,0 +1,57 @@
+#include "camerapath.hpp"
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+bool CameraPath::load(const std::string &filename) {
+    keys.clear();
+    std::ifstream file(filename);
+    if (!file) {
+        std::cerr << "Could not open camera path " << filename << std::endl;
+        return false;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+        std::istringstream fields(line);
+        Key key;
+        key.rotation.z = 0;
+        if (!(fields >> key.time >> key.position.x >> key.position.y >> key.position.z
+                     >> key.rotation.x >> key.rotation.y)) {
+            std::cerr << filename << ":" << lineNumber << ": expected time x y z pitch yaw" << std::endl;
+            continue;
+        }
+        if (!keys.empty() && key.time <= keys.back().time) {
+            std::cerr << filename << ":" << lineNumber << ": key times have to increase" << std::endl;
+            continue;
+        }
+        keys.push_back(key);
+    }
+    if (keys.empty()) std::cerr << "Camera path " << filename << " has no keys" << std::endl;
+    return !keys.empty();
+}
+
+void CameraPath::sample(double time, glm::vec3 &position, glm::vec3 &rotation) const {
+    if (keys.empty()) return;
+    if (keys.size() == 1 || duration() <= 0) {
+        position = keys.front().position;
+        rotation = keys.front().rotation;
+        return;
+    }
+    time = std::fmod(time, duration());
+    if (time < 0) time += duration();
+
+    size_t next = 1;
+    while (next < keys.size() - 1 && keys[next].time < time) next++;
+    const Key &a = keys[next - 1];
+    const Key &b = keys[next];
+    float t = float(glm::clamp((time - a.time) / (b.time - a.time), 0., 1.));
+    position = glm::mix(a.position, b.position, t);
+    rotation = glm::mix(a.rotation, b.rotation, t);
+}
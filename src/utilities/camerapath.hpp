@@ -0,0 +1,26 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Keyframed camera for scripted flythroughs.
+// A path file has one "time x y z pitch yaw" key per line, time in seconds and increasing, '#' starts a comment.
+// Position and angles use the same convention as the keyboard camera, cameraPosition and cameraRotation.
+class CameraPath {
+public:
+    // false if the file can't be read or has no valid keys
+    bool load(const std::string &filename);
+    // linear between keys, wraps around after the last key so short paths can drive long runs
+    void sample(double time, glm::vec3 &position, glm::vec3 &rotation) const;
+    bool empty() const { return keys.empty(); }
+    double duration() const { return keys.empty() ? 0 : keys.back().time; }
+
+private:
+    struct Key {
+        double time;
+        glm::vec3 position;
+        glm::vec3 rotation;
+    };
+    std::vector<Key> keys;
+};
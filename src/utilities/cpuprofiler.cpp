@@ -0,0 +1,96 @@
+#include "cpuprofiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+namespace {
+    struct Event {
+        const char *name;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    // written only by its own thread, head is published after the event so a reader sees whole events
+    struct Ring {
+        uint32_t thread;
+        std::atomic<uint64_t> head{0};
+        Event events[CpuProfiler::RING_SIZE];
+    };
+
+    // rings are never freed, a thread that exits still shows up in the trace
+    std::mutex registryMutex;
+    std::vector<Ring*> registry;
+
+    Ring *threadRing() {
+        thread_local Ring *ring = nullptr;
+        if (!ring) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            ring = new Ring();
+            ring->thread = (uint32_t) registry.size();
+            registry.push_back(ring);
+        }
+        return ring;
+    }
+
+    void writeEscaped(std::ostream &out, const char *text) {
+        for (; *text; ++text) {
+            if (*text == '"' || *text == '\\') out << '\\';
+            out << *text;
+        }
+    }
+}
+
+uint64_t CpuProfiler::now() {
+    using namespace std::chrono;
+    static const steady_clock::time_point start = steady_clock::now();
+    return (uint64_t) duration_cast<microseconds>(steady_clock::now() - start).count();
+}
+
+void CpuProfiler::record(const char *name, uint64_t begin, uint64_t end) {
+    Ring *ring = threadRing();
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    ring->events[head % RING_SIZE] = {name, begin, end};
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+bool CpuProfiler::writeChromeTrace(const std::string &filename) {
+    std::vector<Ring*> rings;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        rings = registry;
+    }
+
+    std::ofstream out(filename);
+    if (!out) return false;
+
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    std::vector<Event> events;
+    for (Ring *ring : rings) {
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t tail = head - std::min<uint64_t>(head, RING_SIZE);
+        events.clear();
+        for (uint64_t i = tail; i < head; ++i) events.push_back(ring->events[i % RING_SIZE]);
+        // the owner may have lapped the oldest events while they were copied, drop those
+        uint64_t newHead = ring->head.load(std::memory_order_acquire);
+        size_t skip = newHead + 1 > tail + RING_SIZE ? std::min<uint64_t>(newHead + 1 - RING_SIZE - tail, events.size()) : 0;
+
+        out << (first ? "" : ",\n")
+            << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << ring->thread
+            << R"(,"args":{"name":")" << (ring->thread == 0 ? "main" : "worker " + std::to_string(ring->thread)) << "\"}}";
+        first = false;
+        for (size_t i = skip; i < events.size(); ++i) {
+            out << ",\n{\"name\":\"";
+            writeEscaped(out, events[i].name);
+            out << R"(","ph":"X","pid":1,"tid":)" << ring->thread
+                << ",\"ts\":" << events[i].begin
+                << ",\"dur\":" << events[i].end - events[i].begin << "}";
+        }
+    }
+    out << "\n]}\n";
+    return (bool) out;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Cpu zones for chrome://tracing (or ui.perfetto.dev).
+// Every thread records into its own ring, so a zone costs two clock reads and a store, no locks.
+// Only the newest RING_SIZE zones per thread are kept, older ones are overwritten.
+// Build without FUR_CPU_PROFILING and the PROFILE_ macros compile to nothing.
+namespace CpuProfiler {
+    const uint32_t RING_SIZE = 1 << 16;
+
+    // microseconds since the profiler was first used
+    uint64_t now();
+    // name must outlive the profiler, string literals are fine
+    void record(const char *name, uint64_t begin, uint64_t end);
+    // writes every thread's ring as trace_event json, returns false if the file can't be opened
+    bool writeChromeTrace(const std::string &filename);
+}
+
+class CpuZone {
+public:
+    explicit CpuZone(const char *name) : name(name), begin(CpuProfiler::now()) {}
+    ~CpuZone() { CpuProfiler::record(name, begin, CpuProfiler::now()); }
+
+private:
+    const char *name;
+    uint64_t begin;
+};
+
+#ifdef FUR_CPU_PROFILING
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) CpuZone PROFILE_CONCAT(cpu_zone_, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#endif
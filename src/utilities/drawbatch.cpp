@@ -0,0 +1,125 @@
+#include "drawbatch.hpp"
+#include "drawstats.hpp"
+#include "shader_uniform_defines.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+DrawData makeDrawData(const glm::mat4 &mvp, const glm::mat4 &model) {
+    DrawData data;
+    data.mvp = mvp;
+    data.model = model;
+    // a rotation times a uniform scale s has the inverse transpose linear / s^2, no inverse needed
+    glm::mat3 linear(model);
+    float scale2 = glm::dot(linear[0], linear[0]);
+    const float tolerance = 1e-4f * scale2;
+    bool uniform = std::abs(glm::dot(linear[1], linear[1]) - scale2) <= tolerance
+                && std::abs(glm::dot(linear[2], linear[2]) - scale2) <= tolerance
+                && std::abs(glm::dot(linear[0], linear[1])) <= tolerance
+                && std::abs(glm::dot(linear[0], linear[2])) <= tolerance
+                && std::abs(glm::dot(linear[1], linear[2])) <= tolerance;
+    glm::mat3 normal_matrix = uniform && scale2 > 0 ? linear * (1.f / scale2) : glm::transpose(glm::inverse(linear));
+    for (int i = 0; i < 3; ++i) {
+        data.normal_matrix[i] = glm::vec4(normal_matrix[i], 0);
+    }
+    return data;
+}
+
+void DrawDataBuffer::beginFrame(int slot, size_t count) {
+    this->slot = slot;
+    this->count = count;
+    ring.reserve(GLsizeiptr(std::max<size_t>(count, 1)) * sizeof(DrawData));
+}
+
+void DrawDataBuffer::bindAll() const {
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, ring.id(), ring.offset(slot),
+                      GLsizeiptr(std::max<size_t>(count, 1)) * sizeof(DrawData));
+}
+
+void DrawDataBuffer::bind(size_t index) const {
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, ring.id(),
+                      ring.offset(slot) + GLintptr(index * sizeof(DrawData)), sizeof(DrawData));
+}
+
+bool BatchMaterial::operator<(const BatchMaterial &other) const {
+    // alpha tested materials sort last, so everything else is one contiguous range
+    return std::tie(alpha_tested, materialID) < std::tie(other.alpha_tested, other.materialID);
+}
+
+bool BatchMaterial::operator==(const BatchMaterial &other) const {
+    return !(*this < other) && !(other < *this);
+}
+
+void DrawBatch::clear() {
+    entries.clear();
+}
+
+void DrawBatch::add(const MeshRange &range, GLuint drawIndex, const BatchMaterial &material) {
+    entries.emplace_back();
+    set(entries.size() - 1, range, drawIndex, material);
+}
+
+void DrawBatch::resize(size_t count) {
+    entries.resize(count);
+}
+
+void DrawBatch::set(size_t index, const MeshRange &range, GLuint drawIndex, const BatchMaterial &material) {
+    Entry &entry = entries[index];
+    entry.material = material;
+    entry.command = {GLuint(range.indexCount), 1, range.firstIndex, range.baseVertex, drawIndex};
+}
+
+void DrawBatch::upload(int slot) {
+    this->slot = slot;
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const Entry &a, const Entry &b) { return a.material < b.material; });
+    if (entries.empty()) return;
+
+    commands.reserve(GLsizeiptr(entries.size()) * sizeof(DrawElementsIndirectCommand));
+    auto mapped = (DrawElementsIndirectCommand*) commands.slot(slot);
+    if (!mapped) return;
+    for (size_t i = 0; i < entries.size(); ++i) mapped[i] = entries[i].command;
+}
+
+void DrawBatch::drawRange(bool multiDraw, const DrawDataBuffer &drawData, size_t first, size_t count) {
+    if (multiDraw) {
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                    (void*)(commands.offset(slot) + first * sizeof(DrawElementsIndirectCommand)),
+                                    count, 0);
+        draw_stats.count(count);
+        return;
+    }
+    // fallback, baseInstance is left out of plain draws so every draw gets its own range
+    for (size_t i = first; i < first + count; ++i) {
+        const auto &command = entries[i].command;
+        drawData.bind(command.baseInstance);
+        glDrawElementsBaseVertex(GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+                                 (void*)(command.firstIndex * sizeof(GLuint)), command.baseVertex);
+        draw_stats.count();
+    }
+}
+
+void DrawBatch::draw(bool multiDraw, const DrawDataBuffer &drawData,
+                     const std::function<void(const BatchMaterial&)> &bindMaterial,
+                     const std::function<bool(const BatchMaterial&)> &include) {
+    if (entries.empty()) return;
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.id());
+    if (multiDraw) drawData.bindAll();
+
+    auto included = [&](size_t i) { return !include || include(entries[i].material); };
+    size_t first = 0;
+    while (first < entries.size()) {
+        size_t last = first + 1;
+        if (bindMaterial) {
+            while (last < entries.size() && entries[last].material == entries[first].material) ++last;
+        } else {
+            while (last < entries.size() && included(last) == included(first)) ++last;
+        }
+        if (included(first)) {
+            if (bindMaterial) bindMaterial(entries[first].material);
+            drawRange(multiDraw, drawData, first, last - first);
+        }
+        first = last;
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <functional>
+#include <vector>
+#include "framepacer.hpp"
+#include "meshpool.hpp"
+
+// Per-draw data, std430 layout mirrored by the DrawData block in the batched shaders.
+// The stride is padded to 256 bytes, the largest SSBO offset alignment GL allows,
+// so any element can start a glBindBufferRange.
+struct DrawData {
+    glm::mat4 mvp;
+    glm::mat4 model;
+    glm::vec4 normal_matrix[3]; // mat3 columns, padded to vec4 like std430 does
+    // surface, fur shell and fur fin MaterialTable index, the last is unused
+    GLuint materials[4] = {};
+    glm::vec4 padding[4];
+};
+static_assert(sizeof(DrawData) == 256, "DrawData must match the shader side stride");
+
+// the normal matrix is the inverse transpose only under non-uniform scale or shear, otherwise a scaled copy of model
+DrawData makeDrawData(const glm::mat4 &mvp, const glm::mat4 &model);
+
+// The DrawData of every object drawn this frame, in a persistently mapped buffer with a copy per frame in flight.
+// Batched draws find theirs through gl_BaseInstanceARB with the whole buffer bound,
+// single draws get the range of their entry bound at DRAW_DATA_BINDING and read element 0.
+class DrawDataBuffer {
+public:
+    // the pacer slot this frame writes, room for count entries. Must come after FramePacer::waitForSlot
+    void beginFrame(int slot, size_t count);
+    // safe from several threads at once for different indices
+    void set(size_t index, const DrawData &data) {
+        if (DrawData *base = entries()) base[index] = data;
+    }
+    void bindAll() const;
+    void bind(size_t index) const;
+    GLsizeiptr bytes() const { return ring.bytes(); }
+
+private:
+    DrawData *entries() { return (DrawData*) ring.slot(slot); }
+
+    FrameRing ring;
+    int slot = 0;
+    size_t count = 0;
+};
+
+// What batched draws are sorted and grouped by, the textures themselves come from the MaterialTable
+struct BatchMaterial {
+    GLuint materialID = 0;
+    // uses discard, so it can't go through the depth pre-pass / early-z path
+    bool alpha_tested = false;
+
+    bool operator<(const BatchMaterial &other) const;
+    bool operator==(const BatchMaterial &other) const;
+};
+
+// Collects pooled draws for a pass and submits them with one glMultiDrawElementsIndirect per material.
+// Each command carries the index of its DrawData in baseInstance.
+class DrawBatch {
+public:
+    void clear();
+    void add(const MeshRange &range, GLuint drawIndex, const BatchMaterial &material);
+    // draws past the old size are empty until set fills them in,
+    // which may run on several threads at once for different indices
+    void resize(size_t count);
+    void set(size_t index, const MeshRange &range, GLuint drawIndex, const BatchMaterial &material);
+    // sort by material and write the commands into the pacer slot of this frame
+    void upload(int slot);
+    // bindMaterial is called once per material group, pass nullptr to merge neighbouring groups into one draw.
+    // include picks which materials to draw, all of them if nullptr.
+    void draw(bool multiDraw, const DrawDataBuffer &drawData,
+              const std::function<void(const BatchMaterial&)> &bindMaterial,
+              const std::function<bool(const BatchMaterial&)> &include = nullptr);
+
+    size_t size() const { return entries.size(); }
+    GLsizeiptr bytes() const { return commands.bytes(); }
+
+private:
+    struct Entry {
+        BatchMaterial material;
+        DrawElementsIndirectCommand command;
+    };
+    void drawRange(bool multiDraw, const DrawDataBuffer &drawData, size_t first, size_t count);
+
+    std::vector<Entry> entries;
+    FrameRing commands;
+    int slot = 0;
+};
@@ -0,0 +1,3 @@
+#include "drawstats.hpp"
+
+DrawStats draw_stats;
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+// Counts what the cpu submits, reset by whoever reads it
+struct DrawStats {
+    // glDraw* / glMultiDraw* calls
+    uint64_t draw_calls = 0;
+    // individual draws, a multi-draw counts once per command
+    uint64_t draws = 0;
+
+    void count(uint64_t drawCount = 1) {
+        draw_calls++;
+        draws += drawCount;
+    }
+    void reset() { *this = DrawStats(); }
+};
+
+extern DrawStats draw_stats;
@@ -0,0 +1,41 @@
+#include "dynamicresolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// scales are kept on a grid so small timing noise never reallocates the targets
+const float SCALE_STEP = 1.0f / 16.0f;
+// only grow when the frame fits this fraction of the budget, so a step up does not overshoot right away
+const float HEADROOM = 0.8f;
+const int COOLDOWN_FRAMES = 30;
+const double SMOOTHING = 0.1;
+
+void DynamicResolution::configure(float targetMilliseconds, float minScale, float maxScale) {
+    target = targetMilliseconds;
+    minimum = minScale;
+    maximum = maxScale;
+    currentScale = std::clamp(currentScale, minimum, maximum);
+}
+
+bool DynamicResolution::update(double gpuMilliseconds) {
+    smoothed = smoothed == 0 ? gpuMilliseconds : smoothed + SMOOTHING * (gpuMilliseconds - smoothed);
+    if (cooldown > 0) {
+        --cooldown;
+        return false;
+    }
+
+    float scale = currentScale;
+    if (smoothed > target) {
+        // cost is proportional to pixel count, so shrink each axis by the square root of the overshoot
+        scale = currentScale * float(std::sqrt(target / smoothed));
+        scale = std::floor(scale / SCALE_STEP) * SCALE_STEP;
+    } else if (smoothed < target * HEADROOM) {
+        scale = currentScale + SCALE_STEP;
+    }
+    scale = std::clamp(scale, minimum, maximum);
+    if (scale == currentScale) return false;
+
+    currentScale = scale;
+    cooldown = COOLDOWN_FRAMES;
+    return true;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+// Picks a render resolution scale that keeps the measured gpu frame time under a target.
+// Scaling down reacts to the overshoot, scaling up creeps one step at a time and only with clear headroom,
+// and every change is followed by a cooldown so the timings of the new size can settle.
+class DynamicResolution {
+public:
+    // scale is per axis, pixel cost goes with its square
+    void configure(float targetMilliseconds, float minScale, float maxScale);
+    // feed one gpu frame time, returns true when scale() changed
+    bool update(double gpuMilliseconds);
+    float scale() const { return currentScale; }
+
+private:
+    float target = 16.6f;
+    float minimum = 0.5f;
+    float maximum = 1.0f;
+    float currentScale = 1.0f;
+    double smoothed = 0;
+    int cooldown = 0;
+};
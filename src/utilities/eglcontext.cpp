@@ -0,0 +1,95 @@
+#include "eglcontext.hpp"
+
+#include <iostream>
+
+#ifdef FUR_HAS_EGL
+#include <cstring>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+namespace {
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+
+    bool hasExtension(const char *extensions, const char *name) {
+        return extensions && std::strstr(extensions, name);
+    }
+}
+
+bool createSurfacelessContext(int major, int minor) {
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (!getPlatformDisplay || !hasExtension(eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS), "EGL_MESA_platform_surfaceless")) {
+        std::cerr << "EGL_MESA_platform_surfaceless is not supported" << std::endl;
+        return false;
+    }
+    display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    EGLint eglMajor, eglMinor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &eglMajor, &eglMinor)) {
+        std::cerr << "Could not initialize the surfaceless EGL display" << std::endl;
+        return false;
+    }
+    if (!hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context")) {
+        std::cerr << "EGL_KHR_surfaceless_context is not supported" << std::endl;
+        destroySurfacelessContext();
+        return false;
+    }
+
+    // the surfaceless platform only has pbuffer configs, the context never uses one
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(display, configAttributes, &config, 1, &configCount)
+        || configCount == 0) {
+        std::cerr << "No EGL config for desktop OpenGL" << std::endl;
+        destroySurfacelessContext();
+        return false;
+    }
+
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, major,
+        EGL_CONTEXT_MINOR_VERSION, minor,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        std::cerr << "Could not create an OpenGL " << major << "." << minor << " core context, EGL error 0x"
+                  << std::hex << eglGetError() << std::dec << std::endl;
+        destroySurfacelessContext();
+        return false;
+    }
+    std::cout << "Surfaceless EGL " << eglMajor << "." << eglMinor << " context" << std::endl;
+    return true;
+}
+
+void destroySurfacelessContext() {
+    if (display == EGL_NO_DISPLAY) return;
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+    eglTerminate(display);
+    context = EGL_NO_CONTEXT;
+    display = EGL_NO_DISPLAY;
+}
+
+void *surfacelessProcAddress(const char *name) {
+    return (void*) eglGetProcAddress(name);
+}
+
+#else
+
+bool createSurfacelessContext(int, int) {
+    std::cerr << "Built without EGL, no surfaceless context" << std::endl;
+    return false;
+}
+
+void destroySurfacelessContext() {}
+
+void *surfacelessProcAddress(const char *) {
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,9 @@
+#pragma once
+
+// OpenGL core context on Mesa's surfaceless EGL platform, no display server or window needed.
+// There is no default framebuffer, everything has to render into framebuffer objects.
+// Only available when CMake found EGL, createSurfacelessContext fails otherwise.
+bool createSurfacelessContext(int major, int minor);
+void destroySurfacelessContext();
+// for gladLoadGLLoader
+void *surfacelessProcAddress(const char *name);
@@ -0,0 +1,240 @@
+#include "framecapture.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <fmt/format.h>
+#include <lodepng.h>
+
+// raw and y4m frames have to reach the file in order, whichever worker finishes first
+struct FrameCapture::Stream {
+    std::ofstream file;
+    int nextFrame = 0;
+    std::map<int, std::vector<unsigned char>> ready;
+};
+
+namespace {
+    unsigned char clampByte(float value) {
+        return (unsigned char) std::min(255.f, std::max(0.f, value + 0.5f));
+    }
+
+    // full range bt.601 4:2:0, the chroma planes average every 2x2 block
+    std::vector<unsigned char> rgbaToI420(const std::vector<unsigned char> &rgba, int width, int height) {
+        int chromaWidth = (width + 1) / 2;
+        int chromaHeight = (height + 1) / 2;
+        std::vector<unsigned char> planes(size_t(width) * height + 2 * size_t(chromaWidth) * chromaHeight);
+        unsigned char *y = planes.data();
+        unsigned char *u = y + size_t(width) * height;
+        unsigned char *v = u + size_t(chromaWidth) * chromaHeight;
+        for (int row = 0; row < height; ++row) {
+            const unsigned char *pixel = &rgba[size_t(row) * width * 4];
+            for (int column = 0; column < width; ++column, pixel += 4) {
+                y[size_t(row) * width + column] = clampByte(0.299f * pixel[0] + 0.587f * pixel[1] + 0.114f * pixel[2]);
+            }
+        }
+        for (int row = 0; row < chromaHeight; ++row) {
+            for (int column = 0; column < chromaWidth; ++column) {
+                float r = 0, g = 0, b = 0;
+                int count = 0;
+                for (int dy = 0; dy < 2 && 2 * row + dy < height; ++dy) {
+                    for (int dx = 0; dx < 2 && 2 * column + dx < width; ++dx) {
+                        const unsigned char *pixel = &rgba[(size_t(2 * row + dy) * width + 2 * column + dx) * 4];
+                        r += pixel[0];
+                        g += pixel[1];
+                        b += pixel[2];
+                        count++;
+                    }
+                }
+                r /= count;
+                g /= count;
+                b /= count;
+                u[size_t(row) * chromaWidth + column] = clampByte(128 - 0.168736f * r - 0.331264f * g + 0.5f * b);
+                v[size_t(row) * chromaWidth + column] = clampByte(128 + 0.5f * r - 0.418688f * g - 0.081312f * b);
+            }
+        }
+        return planes;
+    }
+}
+
+FrameCapture::FrameCapture() = default;
+
+FrameCapture::~FrameCapture() {
+    if (pool) pool->wait();
+    for (Slot &slot : slots) {
+        if (slot.fence) glDeleteSync(slot.fence);
+        if (slot.buffer != 0) glDeleteBuffers(1, &slot.buffer);
+    }
+    if (color != 0) glDeleteTextures(1, &color);
+    if (fb != 0) glDeleteFramebuffers(1, &fb);
+}
+
+bool FrameCapture::open(const std::string &directory, CaptureFormat format, int fps) {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "Could not create capture directory " << directory << ": " << error.message() << std::endl;
+        return false;
+    }
+    this->directory = directory;
+    this->format = format;
+    this->fps = fps;
+    if (!pool) pool = std::make_unique<ThreadPool>();
+    return true;
+}
+
+void FrameCapture::resize(int width, int height) {
+    if (width == this->width && height == this->height) return;
+    finish();
+    this->width = width;
+    this->height = height;
+
+    if (fb == 0) glCreateFramebuffers(1, &fb);
+    if (color != 0) glDeleteTextures(1, &color);
+    glCreateTextures(GL_TEXTURE_2D, 1, &color);
+    glTextureStorage2D(color, 1, GL_RGBA8, width, height);
+    glNamedFramebufferTexture(fb, GL_COLOR_ATTACHMENT0, color, 0);
+
+    for (Slot &slot : slots) {
+        if (slot.buffer != 0) glDeleteBuffers(1, &slot.buffer);
+        glCreateBuffers(1, &slot.buffer);
+        glNamedBufferStorage(slot.buffer, GLsizeiptr(width) * height * 4, nullptr, GL_MAP_READ_BIT);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        freeBuffers.clear();
+    }
+
+    stream.reset();
+    if (isOpen() && format != CaptureFormat::PNG) {
+        stream = std::make_unique<Stream>();
+        stream->nextFrame = frameCount;
+        std::string filename = fmt::format("{}/frames_{}x{}.{}", directory, width, height,
+                                           format == CaptureFormat::Y4M ? "y4m" : "rgba");
+        stream->file.open(filename, std::ios::binary | std::ios::trunc);
+        if (!stream->file) std::cerr << "Could not open " << filename << std::endl;
+        if (format == CaptureFormat::Y4M) {
+            // C420jpeg only gives the chroma siting, players assume limited range unless told otherwise
+            stream->file << fmt::format("YUV4MPEG2 W{} H{} F{}:1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n", width, height, fps);
+        }
+    }
+}
+
+void FrameCapture::capture(GLuint source) {
+    if (!isOpen() || width == 0 || height == 0) return;
+
+    // read back whatever the gpu has finished, then make room if the ring or the encoders are full
+    for (int i = 0; i < RING_SIZE; ++i) {
+        Slot &slot = slots[(next + i) % RING_SIZE];
+        if (slot.frame >= 0 && !collect(slot, false)) break;
+    }
+    bool stalled = false;
+    if (slots[next].frame >= 0) {
+        collect(slots[next], true);
+        stalled = true;
+    }
+    if (pool->pending() >= MAX_ENCODING) {
+        pool->waitUntil(MAX_ENCODING - 1);
+        stalled = true;
+    }
+    if (stalled) stallCount++;
+
+    Slot &slot = slots[next];
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, source);
+    glReadBuffer(source == 0 ? GL_BACK : GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = frameCount++;
+    next = (next + 1) % RING_SIZE;
+}
+
+void FrameCapture::finish() {
+    // oldest first, so streams get their frames in order
+    for (int i = 0; i < RING_SIZE; ++i) {
+        Slot &slot = slots[(next + i) % RING_SIZE];
+        if (slot.frame >= 0) collect(slot, true);
+    }
+    if (pool) pool->wait();
+    if (stream) stream->file.flush();
+}
+
+bool FrameCapture::collect(Slot &slot, bool wait) {
+    GLenum status = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                     wait ? GL_TIMEOUT_IGNORED : 0);
+    if (status == GL_TIMEOUT_EXPIRED) return false;
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+    int frame = slot.frame;
+    slot.frame = -1;
+
+    std::vector<unsigned char> pixels;
+    auto mapped = (const unsigned char*) glMapNamedBuffer(slot.buffer, GL_READ_ONLY);
+    if (status == GL_WAIT_FAILED || !mapped) {
+        std::cerr << "Could not read back captured frame " << frame << std::endl;
+    } else {
+        // gl rows start at the bottom
+        size_t rowSize = size_t(width) * 4;
+        pixels = takeBuffer();
+        pixels.resize(rowSize * height);
+        for (int y = 0; y < height; ++y) {
+            std::memcpy(&pixels[y * rowSize], mapped + (height - 1 - y) * rowSize, rowSize);
+        }
+    }
+    if (mapped) glUnmapNamedBuffer(slot.buffer);
+    // a stream still needs the empty frame to move past it
+    pool->submit([this, frame, pixels = std::move(pixels)]() mutable { encode(frame, std::move(pixels)); });
+    return true;
+}
+
+void FrameCapture::encode(int frame, std::vector<unsigned char> pixels) {
+    if (format == CaptureFormat::PNG) {
+        if (pixels.empty()) return;
+        std::string filename = fmt::format("{}/frame_{:05}.png", directory, frame);
+        unsigned error = lodepng::encode(filename, pixels, width, height);
+        if (error) std::cerr << "Could not write " << filename << ": " << lodepng_error_text(error) << std::endl;
+        else written++;
+        releaseBuffer(std::move(pixels));
+        return;
+    }
+
+    std::vector<unsigned char> data;
+    if (!pixels.empty()) {
+        if (format == CaptureFormat::Y4M) {
+            data = rgbaToI420(pixels, width, height);
+            releaseBuffer(std::move(pixels));
+        } else {
+            data = std::move(pixels);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    stream->ready[frame] = std::move(data);
+    for (auto found = stream->ready.find(stream->nextFrame); found != stream->ready.end();
+         found = stream->ready.find(stream->nextFrame)) {
+        auto &frameData = found->second;
+        if (!frameData.empty()) {
+            if (format == CaptureFormat::Y4M) stream->file << "FRAME\n";
+            if (stream->file.write((const char*) frameData.data(), frameData.size())) written++;
+            if (format == CaptureFormat::RAW) freeBuffers.push_back(std::move(frameData));
+        }
+        stream->ready.erase(found);
+        stream->nextFrame++;
+    }
+}
+
+std::vector<unsigned char> FrameCapture::takeBuffer() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (freeBuffers.empty()) return {};
+    auto buffer = std::move(freeBuffers.back());
+    freeBuffers.pop_back();
+    return buffer;
+}
+
+void FrameCapture::releaseBuffer(std::vector<unsigned char> buffer) {
+    std::lock_guard<std::mutex> lock(mutex);
+    freeBuffers.push_back(std::move(buffer));
+}
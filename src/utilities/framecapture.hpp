@@ -0,0 +1,80 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "threadpool.hpp"
+
+enum class CaptureFormat {
+    PNG, // one frame_00000.png per frame
+    RAW, // every frame appended to one frames_<w>x<h>.rgba file, 8 bit rgba, top row first
+    Y4M, // one frames_<w>x<h>.y4m stream, 4:2:0 full range, plays in ffplay / mpv or pipes into ffmpeg
+};
+
+// Writes rendered frames to disk without stalling the render thread.
+// Each frame is read into the next of RING_SIZE pixel pack buffers with a fence behind it, which only queues a copy.
+// Buffers are mapped once their fence has passed, usually a frame or two later, and only a full ring waits.
+// Encoding and writing run on a thread pool, streams are put back in frame order before they are written.
+class FrameCapture {
+public:
+    static const int RING_SIZE = 3;
+    // frames handed to the pool but not yet written, capture waits beyond this so memory stays bounded
+    static const int MAX_ENCODING = 8;
+
+    FrameCapture();
+    ~FrameCapture();
+
+    // fps only goes into the y4m header, false if the directory can't be written to
+    bool open(const std::string &directory, CaptureFormat format, int fps = 60);
+    bool isOpen() const { return !directory.empty(); }
+    // sizes the readback and the output framebuffer, finishes what is queued first if the size changed
+    void resize(int width, int height);
+    // an rgba8 target for renderFrame to blit into when there is no window to read from
+    GLuint framebuffer() const { return fb; }
+    // queues the readback of a framebuffer of the current size, 0 reads the window's back buffer
+    void capture(GLuint source);
+    // writes every queued frame, blocks until they are on disk
+    void finish();
+    int framesWritten() const { return written; }
+    // captures that had to wait for the gpu or the encoders, more than a few means frames were dropped in real time
+    int stalls() const { return stallCount; }
+
+private:
+    struct Slot {
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+        // frame number, -1 if the slot holds nothing
+        int frame = -1;
+    };
+    struct Stream;
+
+    // maps a slot's buffer and hands the pixels to the pool, blocking on the fence if wait is set
+    bool collect(Slot &slot, bool wait);
+    void encode(int frame, std::vector<unsigned char> pixels);
+    std::vector<unsigned char> takeBuffer();
+    void releaseBuffer(std::vector<unsigned char> buffer);
+
+    std::string directory;
+    CaptureFormat format = CaptureFormat::PNG;
+    int fps = 60;
+    int width = 0;
+    int height = 0;
+    GLuint fb = 0;
+    GLuint color = 0;
+    Slot slots[RING_SIZE];
+    int next = 0;
+    int frameCount = 0;
+    std::atomic<int> written{0};
+    int stallCount = 0;
+
+    // shared with the workers
+    std::mutex mutex;
+    std::vector<std::vector<unsigned char>> freeBuffers;
+    std::unique_ptr<Stream> stream;
+    // started by open, captures that only provide an output framebuffer never need it
+    std::unique_ptr<ThreadPool> pool;
+};
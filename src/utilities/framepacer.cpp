@@ -0,0 +1,165 @@
+#include "framepacer.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <fmt/format.h>
+
+namespace {
+    double seconds() {
+        using namespace std::chrono;
+        static const steady_clock::time_point start = steady_clock::now();
+        return duration<double>(steady_clock::now() - start).count();
+    }
+}
+
+void FramePacer::beginFrame(int framesInFlight) {
+    framesInFlight = std::max(1, std::min(framesInFlight, int(MAX_FRAMES_IN_FLIGHT)));
+    if (framesInFlight != inFlight) {
+        // slots past the new count would never be waited on again
+        collect(true);
+        inFlight = framesInFlight;
+        current = inFlight - 1;
+    }
+    collect(false);
+    current = (current + 1) % inFlight;
+
+    starting = Timings();
+    starting.frame = frameCount++;
+    starting.start = seconds();
+    // recorded when the gpu gets here, reading GL_TIMESTAMP instead would stall on the server every frame
+    startingQuery = startQueries[starting.frame % (MAX_FRAMES_IN_FLIGHT + 1)];
+    if (startingQuery == 0) {
+        glCreateQueries(GL_TIMESTAMP, 1, &startingQuery);
+        startQueries[starting.frame % (MAX_FRAMES_IN_FLIGHT + 1)] = startingQuery;
+    }
+    glQueryCounter(startingQuery, GL_TIMESTAMP);
+    waited = false;
+}
+
+void FramePacer::waitForSlot() {
+    if (waited) return;
+    waited = true;
+    double before = seconds();
+    collect(slots[current], true);
+    starting.wait_ms = (seconds() - before) * 1e3;
+}
+
+void FramePacer::endFrame() {
+    // nothing may have been written this frame, the slot still has to be free before it gets a new fence
+    waitForSlot();
+    Slot &slot = slots[current];
+    if (slot.query == 0) glCreateQueries(GL_TIMESTAMP, 1, &slot.query);
+    glQueryCounter(slot.query, GL_TIMESTAMP);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.startQuery = startingQuery;
+    slot.timings = starting;
+}
+
+void FramePacer::limit(float fps) {
+    using clock = std::chrono::steady_clock;
+    if (fps <= 0) return;
+    auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1. / fps));
+    auto now = clock::now();
+    if (now < nextPresent) {
+        std::this_thread::sleep_until(nextPresent);
+        nextPresent += period;
+    } else {
+        // fell behind, start over rather than rushing the next frames to catch up
+        nextPresent = now + period;
+    }
+}
+
+void FramePacer::collect(bool wait) {
+    // oldest first, fences pass in submission order
+    for (int i = 1; i <= inFlight; ++i) {
+        if (!collect(slots[(current + i) % inFlight], wait)) break;
+    }
+}
+
+bool FramePacer::collect(Slot &slot, bool wait) {
+    if (!slot.fence) return true;
+    GLenum status = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                     wait ? GL_TIMEOUT_IGNORED : 0);
+    if (status == GL_TIMEOUT_EXPIRED) return false;
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+    if (status == GL_WAIT_FAILED) {
+        std::cerr << "Waiting for frame " << slot.timings.frame << " failed" << std::endl;
+        return true;
+    }
+
+    // both queries were issued before the fence, so they are done too
+    GLint64 start = 0, end = 0;
+    glGetQueryObjecti64v(slot.startQuery, GL_QUERY_RESULT, &start);
+    glGetQueryObjecti64v(slot.query, GL_QUERY_RESULT, &end);
+    slot.timings.latency_ms = (end - start) / 1e6;
+    history[slot.timings.frame % HISTORY] = slot.timings;
+    latestNumber = slot.timings.frame;
+    return true;
+}
+
+bool FramePacer::timings(int frame, Timings &out) const {
+    if (frame < 0 || frame > latestNumber) return false;
+    const Timings &found = history[frame % HISTORY];
+    if (found.frame != frame) return false;
+    out = found;
+    return true;
+}
+
+void FramePacer::report(std::ostream &out) const {
+    std::vector<Timings> frames;
+    for (const auto &frame : history) {
+        if (frame.frame >= 0) frames.push_back(frame);
+    }
+    if (frames.size() < 2) {
+        out << "no finished frames yet" << std::endl;
+        return;
+    }
+    std::sort(frames.begin(), frames.end(), [](const Timings &a, const Timings &b) { return a.frame < b.frame; });
+
+    std::vector<double> waits, latencies;
+    for (const auto &frame : frames) {
+        waits.push_back(frame.wait_ms);
+        latencies.push_back(frame.latency_ms);
+    }
+    auto average = [](const std::vector<double> &values) {
+        double sum = 0;
+        for (double value : values) sum += value;
+        return sum / values.size();
+    };
+    auto percentile = [](std::vector<double> values, double p) {
+        std::sort(values.begin(), values.end());
+        return values[size_t(p * (values.size() - 1))];
+    };
+    double elapsed = frames.back().start - frames.front().start;
+    out << fmt::format("{:.1f} fps, {} frames in flight, fence wait avg {:.3f} ms, latency avg {:.3f} ms p95 {:.3f}",
+                       elapsed > 0 ? (frames.size() - 1) / elapsed : 0., inFlight,
+                       average(waits), average(latencies), percentile(latencies, 0.95)) << std::endl;
+}
+
+void FrameRing::reserve(GLsizeiptr size) {
+    if (size <= this->size) return;
+    if (buffer != 0) glDeleteBuffers(1, &buffer);
+
+    if (alignment == 0) {
+        GLint uniformAlignment = 1, storageAlignment = 1;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+        alignment = std::max(1, std::max(uniformAlignment, storageAlignment));
+    }
+    // counts like the visible draws change every frame, doubling keeps the reallocations rare
+    this->size = std::max(size, 2 * this->size);
+    stride = (this->size + alignment - 1) / alignment * alignment;
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &buffer);
+    glNamedBufferStorage(buffer, stride * FramePacer::MAX_FRAMES_IN_FLIGHT, nullptr, flags);
+    mapped = (unsigned char*) glMapNamedBufferRange(buffer, 0, stride * FramePacer::MAX_FRAMES_IN_FLIGHT, flags);
+    if (!mapped) std::cerr << "Could not map the per-frame buffer" << std::endl;
+}
+
+void FrameRing::bind(GLenum target, GLuint binding, int index) const {
+    glBindBufferRange(target, binding, buffer, index * stride, size);
+}
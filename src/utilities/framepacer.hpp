@@ -0,0 +1,96 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <chrono>
+#include <ostream>
+
+// Lets the cpu prepare frames while the gpu is still drawing earlier ones, but never more than frames in flight.
+// Every frame takes the next slot, data it hands to the gpu goes into that slot of each FrameRing,
+// and the slot is only written again once the fence behind its frame has passed.
+// The fences double as a latency measure, timestamps queried at beginFrame and endFrame are read once they pass.
+class FramePacer {
+public:
+    static const int MAX_FRAMES_IN_FLIGHT = 3;
+    static const int HISTORY = 240;
+
+    struct Timings {
+        int frame = -1;
+        // seconds on the steady clock when the frame began
+        double start = 0;
+        // how long the cpu blocked on the fence before it could write the slot
+        double wait_ms = 0;
+        // from the gpu reaching beginFrame until it finished the frame's commands, frames queued ahead of it
+        // are not counted but gaps waiting on the cpu are
+        double latency_ms = 0;
+    };
+
+    // starts the next frame, framesInFlight is clamped to 1..MAX_FRAMES_IN_FLIGHT, changing it drains the gpu
+    void beginFrame(int framesInFlight);
+    // blocks until the gpu is done with the frame that last used this slot, once per frame
+    void waitForSlot();
+    // fences everything submitted since beginFrame
+    void endFrame();
+    int slot() const { return current; }
+    int framesInFlight() const { return inFlight; }
+    // sleeps so calls are at least 1/fps apart, 0 does nothing
+    void limit(float fps);
+
+    // reads every finished frame, blocking until they all are if wait is set
+    void collect(bool wait);
+    // the newest finished frame, numbered in beginFrame order starting at 0, -1 before the first one
+    int latestFrame() const { return latestNumber; }
+    // false if the frame is unfinished or older than HISTORY
+    bool timings(int frame, Timings &out) const;
+    // frames per second, fence waits and latency over the history
+    void report(std::ostream &out) const;
+
+private:
+    struct Slot {
+        GLsync fence = nullptr;
+        GLuint query = 0;
+        GLuint startQuery = 0;
+        Timings timings;
+    };
+
+    bool collect(Slot &slot, bool wait);
+
+    Slot slots[MAX_FRAMES_IN_FLIGHT];
+    int current = 0;
+    int inFlight = 1;
+    int frameCount = 0;
+    // the frame being prepared, it moves into its slot at endFrame
+    Timings starting;
+    // by frame number, one more than can be in flight, so beginFrame never reuses one that has not been read
+    GLuint startQueries[MAX_FRAMES_IN_FLIGHT + 1] = {};
+    GLuint startingQuery = 0;
+    bool waited = false;
+    int latestNumber = -1;
+    Timings history[HISTORY];
+    std::chrono::steady_clock::time_point nextPresent;
+};
+
+// A persistently mapped buffer with a copy of some per-frame data for every slot of a FramePacer.
+// Writing a slot is only safe after FramePacer::waitForSlot, the mapping is coherent so nothing needs flushing.
+class FrameRing {
+public:
+    // size is the data of one frame, each copy starts at an offset any buffer binding accepts.
+    // Asking for more than there is makes a new buffer, at least twice as large, and drops what was written,
+    // the old one is only freed by GL once the frames still reading it are done.
+    void reserve(GLsizeiptr size);
+    GLsizeiptr capacity() const { return size; }
+    // all the copies together
+    GLsizeiptr bytes() const { return stride * FramePacer::MAX_FRAMES_IN_FLIGHT; }
+    // nullptr if the buffer could not be mapped
+    void *slot(int index) { return mapped ? mapped + index * stride : nullptr; }
+    void bind(GLenum target, GLuint binding, int index) const;
+    GLuint id() const { return buffer; }
+    GLintptr offset(int index) const { return index * stride; }
+
+private:
+    GLuint buffer = 0;
+    GLsizeiptr size = 0;
+    GLsizeiptr stride = 0;
+    // of both uniform and storage buffer offsets, queried on the first reserve
+    GLsizeiptr alignment = 0;
+    unsigned char *mapped = nullptr;
+};
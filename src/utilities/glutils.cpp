@@ -14,19 +14,11 @@ unsigned int generateAttribute(int id, int elementsPerEntry, std::vector<T> data
     return bufferID;
 }
 
-unsigned int generateBuffer(Mesh &mesh) {
-    unsigned int vaoID;
-    glGenVertexArrays(1, &vaoID);
-    glBindVertexArray(vaoID);
-
-    generateAttribute(0, 3, mesh.vertices, false);
-    generateAttribute(1, 3, mesh.normals, true);
-    if (mesh.textureCoordinates.size() > 0) {
-        generateAttribute(2, 2, mesh.textureCoordinates, false);
-    }
-
+std::vector<glm::vec3> generateTangents(Mesh &mesh) {
     std::vector<glm::vec3> tangents(mesh.normals.size());
 
+    if (mesh.textureCoordinates.size() < mesh.normals.size()) return tangents; // no uvs, no tangent space
+
     for (int i = 0; i < mesh.normals.size(); i += 3){
         // http://www.opengl-tutorial.org/intermediate-tutorials/tutorial-13-normal-mapping/
         // Shortcuts for vertices
@@ -52,7 +44,21 @@ unsigned int generateBuffer(Mesh &mesh) {
         tangent = glm::normalize(tangent);
         tangents.at(i) = tangents.at(i+1) = tangents.at(i+2) = tangent;
     }
+    return tangents;
+}
+
+unsigned int generateBuffer(Mesh &mesh) {
+    unsigned int vaoID;
+    glGenVertexArrays(1, &vaoID);
+    glBindVertexArray(vaoID);
+
+    generateAttribute(0, 3, mesh.vertices, false);
+    generateAttribute(1, 3, mesh.normals, true);
+    if (mesh.textureCoordinates.size() > 0) {
+        generateAttribute(2, 2, mesh.textureCoordinates, false);
+    }
 
+    std::vector<glm::vec3> tangents = generateTangents(mesh);
     generateAttribute(3, 3, tangents, true);
 
     unsigned int indexBufferID;
@@ -2,4 +2,5 @@
 
 #include "mesh.hpp"
 
-unsigned int generateBuffer(Mesh &mesh);
\ No newline at end of file
+std::vector<glm::vec3> generateTangents(Mesh &mesh);
+unsigned int generateBuffer(Mesh &mesh);
@@ -0,0 +1,105 @@
+#include "gpuprofiler.hpp"
+
+#include <algorithm>
+#include <fmt/format.h>
+
+GLuint GpuProfiler::acquireQuery() {
+    if (freeQueries.empty()) {
+        GLuint queries[16];
+        glCreateQueries(GL_TIMESTAMP, 16, queries);
+        freeQueries.insert(freeQueries.end(), queries, queries + 16);
+    }
+    GLuint query = freeQueries.back();
+    freeQueries.pop_back();
+    return query;
+}
+
+void GpuProfiler::collect(Frame &frame) {
+    if (!frame.recorded) return;
+    frame.recorded = false;
+
+    // the root zone's end is the last query of the frame, if it is done the gpu is through all of them
+    GLint available = 0;
+    if (!frame.zones.empty()) {
+        glGetQueryObjectiv(frame.zones.front().end, GL_QUERY_RESULT_AVAILABLE, &available);
+    }
+    std::map<std::string, double> frameTimes;
+    for (const auto &zone : frame.zones) {
+        if (available) {
+            GLuint64 begin, end;
+            glGetQueryObjectui64v(zone.begin, GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(zone.end, GL_QUERY_RESULT, &end);
+            frameTimes[zone.path] += (end - begin) / 1e6;
+            if (stats.find(zone.path) == stats.end()) order.push_back(zone.path);
+            stats[zone.path].depth = zone.depth;
+        }
+        freeQueries.push_back(zone.begin);
+        freeQueries.push_back(zone.end);
+    }
+    frame.zones.clear();
+    if (available) {
+        latestNumber = frame.number;
+        latest = frameTimes;
+    }
+
+    for (const auto &entry : frameTimes) {
+        Stats &stat = stats[entry.first];
+        if (stat.samples.size() < HISTORY) {
+            stat.samples.push_back(entry.second);
+        } else {
+            stat.samples[stat.next] = entry.second;
+        }
+        stat.next = (stat.next + 1) % HISTORY;
+    }
+}
+
+void GpuProfiler::beginFrame() {
+    current = (current + 1) % FRAME_LATENCY;
+    collect(frames[current]);
+    recording = enabled;
+    frames[current].number = frameCount++;
+    if (recording) push("frame");
+}
+
+void GpuProfiler::endFrame() {
+    if (!recording) return;
+    while (!open.empty()) pop();
+    frames[current].recorded = true;
+    recording = false;
+}
+
+void GpuProfiler::push(const std::string &name) {
+    if (!recording) return;
+    Frame &frame = frames[current];
+    Zone zone;
+    zone.path = open.empty() ? name : frame.zones[open.back()].path + "/" + name;
+    zone.depth = int(open.size());
+    zone.begin = acquireQuery();
+    zone.end = acquireQuery();
+    glQueryCounter(zone.begin, GL_TIMESTAMP);
+    open.push_back(frame.zones.size());
+    frame.zones.push_back(zone);
+}
+
+void GpuProfiler::pop() {
+    if (!recording || open.empty()) return;
+    glQueryCounter(frames[current].zones[open.back()].end, GL_TIMESTAMP);
+    open.pop_back();
+}
+
+void GpuProfiler::report(std::ostream &out) const {
+    for (const auto &path : order) {
+        const Stats &stat = stats.at(path);
+        if (stat.samples.empty()) continue;
+        std::vector<double> sorted = stat.samples;
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0;
+        for (double sample : sorted) sum += sample;
+        auto percentile = [&](double p) { return sorted[size_t(p * (sorted.size() - 1))]; };
+
+        std::string name = std::string(stat.depth * 2, ' ') + path.substr(path.rfind('/') + 1);
+        out << fmt::format("{:<32} avg {:6.3f} ms  p50 {:6.3f}  p95 {:6.3f}  p99 {:6.3f}",
+                           name, sum / sorted.size(),
+                           percentile(0.5), percentile(0.95), percentile(0.99)) << std::endl;
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Hierarchical gpu timings from GL_TIMESTAMP queries.
+// Zones are pushed and popped while a frame is recorded, their queries are read FRAME_LATENCY frames later
+// when the gpu is long done with them, so the cpu never waits. Zones with the same path in one frame are summed,
+// and every path keeps a window of per-frame times for averages and percentiles.
+class GpuProfiler {
+public:
+    static const int FRAME_LATENCY = 4;
+    static const int HISTORY = 240;
+
+    bool enabled = false;
+
+    // reads back the frame recorded FRAME_LATENCY frames ago and starts recording a new one
+    void beginFrame();
+    void endFrame();
+    void push(const std::string &name);
+    void pop();
+
+    // one line per zone, indented by depth: average, median, 95th and 99th percentile in ms
+    void report(std::ostream &out) const;
+
+    // the newest frame read back, numbered in beginFrame order starting at 0, -1 before the first one
+    int latestFrame() const { return latestNumber; }
+    // ms per zone path of that frame
+    const std::map<std::string, double> &latestTimes() const { return latest; }
+    // every zone path seen so far, in frame order
+    const std::vector<std::string> &paths() const { return order; }
+
+private:
+    struct Zone {
+        std::string path;
+        int depth;
+        GLuint begin;
+        GLuint end;
+    };
+    struct Frame {
+        std::vector<Zone> zones;
+        bool recorded = false;
+        int number = 0;
+    };
+    struct Stats {
+        int depth = 0;
+        std::vector<double> samples;
+        size_t next = 0;
+    };
+
+    GLuint acquireQuery();
+    void collect(Frame &frame);
+
+    Frame frames[FRAME_LATENCY];
+    int current = 0;
+    int frameCount = 0;
+    int latestNumber = -1;
+    std::map<std::string, double> latest;
+    bool recording = false;
+    std::vector<size_t> open;
+    std::vector<GLuint> freeQueries;
+    std::map<std::string, Stats> stats;
+    // paths in the order they were first seen, so the report follows the frame
+    std::vector<std::string> order;
+};
+
+// Times its scope as a zone of profiler
+class GpuZone {
+public:
+    GpuZone(GpuProfiler &profiler, const std::string &name) : profiler(profiler) { profiler.push(name); }
+    ~GpuZone() { profiler.pop(); }
+
+private:
+    GpuProfiler &profiler;
+};
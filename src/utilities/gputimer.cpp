@@ -0,0 +1,52 @@
+#include "gputimer.hpp"
+
+#include <iostream>
+
+void GpuQueryRing::begin() {
+    if (queries[0] == 0) glCreateQueries(target, RING_SIZE, queries);
+    if (pending[next]) {
+        // the gpu is more than RING_SIZE frames behind, drop the oldest result rather than wait for it
+        pending[next] = false;
+        oldest = (next + 1) % RING_SIZE;
+    }
+    sequence[next] = count++;
+    glBeginQuery(target, queries[next]);
+    running = true;
+}
+
+void GpuQueryRing::end() {
+    if (!running) {
+        std::cerr << "GpuQueryRing::end without begin" << std::endl;
+        return;
+    }
+    glEndQuery(target);
+    pending[next] = true;
+    next = (next + 1) % RING_SIZE;
+    running = false;
+}
+
+bool GpuQueryRing::poll(GLuint64 &result) {
+    bool found = false;
+    int index;
+    while (pollNext(result, index)) found = true;
+    return found;
+}
+
+bool GpuQueryRing::pollNext(GLuint64 &result, int &index) {
+    if (!pending[oldest]) return false;
+    GLint available = 0;
+    glGetQueryObjectiv(queries[oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) return false;
+    glGetQueryObjectui64v(queries[oldest], GL_QUERY_RESULT, &result);
+    index = sequence[oldest];
+    pending[oldest] = false;
+    oldest = (oldest + 1) % RING_SIZE;
+    return true;
+}
+
+bool GpuTimer::poll(double &milliseconds) {
+    GLuint64 nanoseconds = 0;
+    if (!ring.poll(nanoseconds)) return false;
+    milliseconds = nanoseconds / 1e6;
+    return true;
+}
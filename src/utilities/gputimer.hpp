@@ -0,0 +1,40 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Brackets gpu work with begin / end queries of one target, GL_TIME_ELAPSED, GL_PRIMITIVES_GENERATED and the like.
+// Results are read a few frames late from a ring of queries, so reading never stalls the pipeline.
+class GpuQueryRing {
+public:
+    static const int RING_SIZE = 4;
+
+    explicit GpuQueryRing(GLenum target) : target(target) {}
+
+    void begin();
+    void end();
+    // the newest finished result, false if none has finished since the last call
+    bool poll(GLuint64 &result);
+    // the oldest finished result and which begin it belongs to, counting from 0
+    bool pollNext(GLuint64 &result, int &index);
+
+private:
+    GLenum target;
+    GLuint queries[RING_SIZE] = {};
+    bool pending[RING_SIZE] = {};
+    int sequence[RING_SIZE] = {};
+    int count = 0;
+    int next = 0;
+    int oldest = 0;
+    bool running = false;
+};
+
+// Measures gpu time between begin and end with GL_TIME_ELAPSED queries
+class GpuTimer {
+public:
+    void begin() { ring.begin(); }
+    void end() { ring.end(); }
+    bool poll(double &milliseconds);
+
+private:
+    GpuQueryRing ring{GL_TIME_ELAPSED};
+};
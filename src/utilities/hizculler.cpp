@@ -0,0 +1,84 @@
+#include "hizculler.hpp"
+#include "shader_uniform_defines.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+const int HIZ_GROUP_SIZE = 8;
+const int CULL_GROUP_SIZE = 64;
+
+CullObject makeCullObject(const MeshRange &range, const AABB &worldBounds, bool frustumVisible) {
+    CullObject object;
+    object.boundsMin = glm::vec4(worldBounds.min, 1);
+    object.boundsMax = glm::vec4(worldBounds.max, 1);
+    object.count = range.indexCount;
+    object.firstIndex = range.firstIndex;
+    object.baseVertex = range.baseVertex;
+    object.frustumVisible = frustumVisible;
+    return object;
+}
+
+void HiZCuller::initialize() {
+    downsampleShader = new Gloom::Shader();
+    downsampleShader->attach("../res/shaders/hiz_downsample.comp");
+    downsampleShader->link();
+
+    cullShader = new Gloom::Shader();
+    cullShader->attach("../res/shaders/hiz_cull.comp");
+    cullShader->link();
+
+    glCreateBuffers(1, &objectBufferID);
+    glCreateBuffers(1, &commandBufferID);
+}
+
+void HiZCuller::resize(int width, int height) {
+    if (width == pyramidWidth && height == pyramidHeight) return;
+    if (pyramidID != 0) glDeleteTextures(1, &pyramidID);
+
+    pyramidWidth = width;
+    pyramidHeight = height;
+    pyramidLevels = 1 + int(std::floor(std::log2(std::max(width, height))));
+    glCreateTextures(GL_TEXTURE_2D, 1, &pyramidID);
+    glTextureStorage2D(pyramidID, pyramidLevels, GL_R32F, width, height);
+    glTextureParameteri(pyramidID, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTextureParameteri(pyramidID, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+void HiZCuller::buildPyramid(GLuint depthTexture) {
+    downsampleShader->activate();
+    int width = pyramidWidth;
+    int height = pyramidHeight;
+    for (int level = 0; level < pyramidLevels; ++level) {
+        // level 0 copies the depth buffer, every other level takes the max of the one above
+        glBindTextureUnit(HIZ_SOURCE_SAMPLER, level == 0 ? depthTexture : pyramidID);
+        glBindImageTexture(HIZ_DESTINATION_IMAGE, pyramidID, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glUniform1i(UNIFORM_HIZ_SOURCE_LEVEL_LOC, level == 0 ? 0 : level - 1);
+        glUniform1i(UNIFORM_HIZ_COPY_LOC, level == 0);
+
+        glDispatchCompute((width + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, (height + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+}
+
+void HiZCuller::cull(const std::vector<CullObject> &objects, const glm::mat4 &VP, bool usePyramid) {
+    if (objects.empty()) return;
+    glNamedBufferData(objectBufferID, objects.size() * sizeof(CullObject), objects.data(), GL_STREAM_DRAW);
+    glNamedBufferData(commandBufferID, objects.size() * sizeof(DrawElementsIndirectCommand), nullptr, GL_STREAM_DRAW);
+
+    cullShader->activate();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, HIZ_OBJECT_BINDING, objectBufferID);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, HIZ_COMMAND_BINDING, commandBufferID);
+    glBindTextureUnit(HIZ_SOURCE_SAMPLER, pyramidID);
+    glUniformMatrix4fv(UNIFORM_HIZ_VP_LOC, 1, GL_FALSE, glm::value_ptr(VP));
+    glUniform1ui(UNIFORM_HIZ_OBJECT_COUNT_LOC, objects.size());
+    glUniform1i(UNIFORM_HIZ_USE_PYRAMID_LOC, usePyramid);
+
+    glDispatchCompute((objects.size() + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+    // the commands are read by indirect draws
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
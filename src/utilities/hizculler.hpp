@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "meshpool.hpp"
+#include "shader.hpp"
+
+// One object for the occlusion test, std430 layout mirrored in hiz_cull.comp
+struct CullObject {
+    glm::vec4 boundsMin;
+    glm::vec4 boundsMax;
+    GLuint count;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint frustumVisible;
+};
+
+CullObject makeCullObject(const MeshRange &range, const AABB &worldBounds, bool frustumVisible);
+
+// Builds a max-depth pyramid from a depth texture and tests object bounds against it on the gpu.
+// The result is one DrawElementsIndirectCommand per object, with instanceCount 0 when it is hidden.
+class HiZCuller {
+public:
+    void initialize();
+    // (re)allocates the pyramid, mip 0 matches the depth buffer
+    void resize(int width, int height);
+    void buildPyramid(GLuint depthTexture);
+    // tests against the pyramid as it was seen through VP, usePyramid false only applies frustumVisible
+    void cull(const std::vector<CullObject> &objects, const glm::mat4 &VP, bool usePyramid);
+
+    GLuint commandBuffer() const { return commandBufferID; }
+    // its programs, for hot reload
+    std::vector<Gloom::Shader*> shaders() const { return {downsampleShader, cullShader}; }
+
+private:
+    Gloom::Shader* downsampleShader = nullptr;
+    Gloom::Shader* cullShader = nullptr;
+    GLuint pyramidID = 0;
+    int pyramidLevels = 0;
+    int pyramidWidth = 0;
+    int pyramidHeight = 0;
+    GLuint objectBufferID = 0;
+    GLuint commandBufferID = 0;
+};
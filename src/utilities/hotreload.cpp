@@ -0,0 +1,139 @@
+#include "hotreload.hpp"
+
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+bool HotReloader::start(const std::vector<std::string> &folders, ContextBinder bindContext) {
+#ifdef __linux__
+    if (running()) stop();
+    inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify == -1) {
+        std::cerr << "Could not start inotify, hot reload is off" << std::endl;
+        return false;
+    }
+    for (const auto &folder : folders) {
+        // editors either write the file in place or move a new one over it
+        int watch = inotify_add_watch(inotify, folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (watch == -1) std::cerr << "Could not watch " << folder << " for changes" << std::endl;
+        else this->folders[watch] = folder;
+    }
+    this->bindContext = std::move(bindContext);
+    loader = std::make_unique<ThreadPool>(1);
+    // one thread, the context stays current for every job after this one
+    if (this->bindContext) loader->submit([this] { this->bindContext(true); });
+    return true;
+#else
+    std::cerr << "Hot reload needs inotify, it is off" << std::endl;
+    return false;
+#endif
+}
+
+void HotReloader::stop() {
+    if (!running()) return;
+    if (bindContext) loader->submit([this] { bindContext(false); });
+    loader.reset();
+    // linked but never applied, they belong to the share group, which the main context keeps alive
+    for (const auto &build : built) glDeleteProgram(build.program);
+    built.clear();
+    loaded.clear();
+#ifdef __linux__
+    close(inotify);
+#endif
+    inotify = -1;
+    folders.clear();
+}
+
+void HotReloader::watch(Gloom::Shader *shader) {
+    shaders.push_back(shader);
+}
+
+std::set<std::string> HotReloader::readChanges() {
+    std::set<std::string> changed;
+#ifdef __linux__
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length;
+    while ((length = read(inotify, buffer, sizeof(buffer))) > 0) {
+        for (char *at = buffer; at < buffer + length;) {
+            auto event = reinterpret_cast<const inotify_event*>(at);
+            at += sizeof(inotify_event) + event->len;
+            auto folder = folders.find(event->wd);
+            if (event->len == 0 || folder == folders.end()) continue;
+            changed.insert(folder->second + "/" + event->name);
+        }
+    }
+#endif
+    return changed;
+}
+
+bool HotReloader::poll() {
+    if (!running()) return false;
+
+    std::set<Gloom::Shader*> rebuilt;
+    std::set<const CachedTexture*> reloaded;
+    for (const auto &filename : readChanges()) {
+        bool used = false;
+        for (auto shader : shaders) {
+            if (!shader->uses(filename)) continue;
+            used = true;
+            if (rebuilt.insert(shader).second) rebuild(shader);
+        }
+        for (const auto &texture : resource_cache.texturesFrom(filename)) {
+            used = true;
+            // all six faces of a cubemap are usually saved together
+            if (!reloaded.insert(texture.get()).second) continue;
+            std::weak_ptr<const CachedTexture> weak = texture;
+            GLenum target = texture->target;
+            std::string source = texture->filename;
+            loader->submit([this, weak, target, source] {
+                auto images = ResourceCache::readImages(target, source);
+                std::lock_guard<std::mutex> lock(finishedMutex);
+                loaded.push_back({weak, std::move(images)});
+            });
+        }
+        if (used) std::cout << "Reloading " << filename << std::endl;
+    }
+
+    std::vector<Build> builds;
+    std::vector<Load> loads;
+    {
+        std::lock_guard<std::mutex> lock(finishedMutex);
+        builds.swap(built);
+        loads.swap(loaded);
+    }
+    for (const auto &build : builds) finish(build);
+    bool replaced = false;
+    for (auto &load : loads) {
+        auto texture = load.texture.lock();
+        if (texture && resource_cache.reload(texture, std::move(load.images))) replaced = true;
+    }
+    return replaced;
+}
+
+void HotReloader::rebuild(Gloom::Shader *shader) {
+    if (!bindContext) {
+        Build build {shader, 0, {}};
+        build.program = shader->rebuild(build.log);
+        finish(build);
+        return;
+    }
+    loader->submit([this, shader] {
+        Build build {shader, 0, {}};
+        build.program = shader->rebuild(build.log);
+        // complete before the main context starts using it
+        glFinish();
+        std::lock_guard<std::mutex> lock(finishedMutex);
+        built.push_back(std::move(build));
+    });
+}
+
+void HotReloader::finish(const Build &build) {
+    if (build.program == 0) {
+        std::cerr << build.log << "Keeping the previous program" << std::endl;
+        return;
+    }
+    build.shader->replace(build.program);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "resourcecache.hpp"
+#include "shader.hpp"
+#include "threadpool.hpp"
+
+// Reloads shaders and cached textures while the game runs, whenever their files in the watched folders change.
+// Watching needs inotify, elsewhere start fails and nothing is reloaded.
+// A changed file rebuilds every watched program that attached it, on the loader thread when it was given a context
+// sharing objects with the main one, else on the main thread. The new program replaces the old one only once it
+// links, a broken edit prints its log and the old program keeps drawing.
+// Textures from a changed file are decoded on the loader thread and put behind their handles by ResourceCache::reload.
+class HotReloader {
+public:
+    // makes a context sharing objects with the main one current on the calling thread, or releases it with false
+    using ContextBinder = std::function<void(bool)>;
+
+    ~HotReloader() { stop(); }
+
+    // watches the files directly in folders, without bindContext programs are rebuilt on the main thread
+    bool start(const std::vector<std::string> &folders, ContextBinder bindContext = nullptr);
+    // finishes what the loader is doing and releases its context. Call it while the main one is current
+    void stop();
+    bool running() const { return inotify != -1; }
+    // rebuilt when any file it attached changes
+    void watch(Gloom::Shader *shader);
+
+    // picks up changed files and applies what the loader finished, once a frame on the main thread.
+    // Returns true when a texture got a new id, materials have to be registered again before drawing
+    bool poll();
+
+private:
+    struct Build {
+        Gloom::Shader *shader;
+        // 0 when it did not compile or link
+        GLuint program;
+        std::string log;
+    };
+    struct Load {
+        std::weak_ptr<const CachedTexture> texture;
+        std::vector<PNGImage> images;
+    };
+
+    // the changed files since the last poll, editors write several events per save
+    std::set<std::string> readChanges();
+    void rebuild(Gloom::Shader *shader);
+    void finish(const Build &build);
+
+    int inotify = -1;
+    // folder of each inotify watch descriptor
+    std::map<int, std::string> folders;
+    std::vector<Gloom::Shader*> shaders;
+    ContextBinder bindContext;
+    // filled by the loader thread
+    std::mutex finishedMutex;
+    std::vector<Build> built;
+    std::vector<Load> loaded;
+    // last, so it finishes its jobs before what they write to goes away
+    std::unique_ptr<ThreadPool> loader;
+};
@@ -1,4 +1,5 @@
 #include "imageLoader.hpp"
+#include <algorithm>
 #include <iostream>
 
 // Original source: https://raw.githubusercontent.com/lvandeve/lodepng/master/examples/example_decode.cpp
@@ -43,4 +44,31 @@ PNGImage loadPNGFile(std::string fileName)
 
 	return image;
 
-}
\ No newline at end of file
+}
+
+void shrinkPNGImage(PNGImage &image, GLsizei size)
+{
+	size = std::max(size, 1);
+	while (image.width > size || image.height > size) {
+		GLsizei width = std::max(1, image.width / 2);
+		GLsizei height = std::max(1, image.height / 2);
+		std::vector<unsigned char> pixels(size_t(width) * height * 4);
+		for (GLsizei y = 0; y < height; y++) {
+			// odd sizes drop the last row or column, a side of one is read twice
+			GLsizei y0 = std::min(2 * y, image.height - 1), y1 = std::min(2 * y + 1, image.height - 1);
+			for (GLsizei x = 0; x < width; x++) {
+				GLsizei x0 = std::min(2 * x, image.width - 1), x1 = std::min(2 * x + 1, image.width - 1);
+				for (int c = 0; c < 4; c++) {
+					unsigned sum = image.pixels[(size_t(y0) * image.width + x0) * 4 + c]
+					             + image.pixels[(size_t(y0) * image.width + x1) * 4 + c]
+					             + image.pixels[(size_t(y1) * image.width + x0) * 4 + c]
+					             + image.pixels[(size_t(y1) * image.width + x1) * 4 + c];
+					pixels[(size_t(y) * width + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+		image.width = width;
+		image.height = height;
+		image.pixels = std::move(pixels);
+	}
+}
@@ -12,3 +12,5 @@ typedef struct PNGImage {
 } PNGImage;
 
 PNGImage loadPNGFile(std::string fileName);
+// halves the image with a box filter until neither side is above size, the way mipmaps are made
+void shrinkPNGImage(PNGImage &image, GLsizei size);
@@ -0,0 +1,114 @@
+#include "jobsystem.hpp"
+
+#include <algorithm>
+
+namespace {
+    // the deque the current thread pushes to, 0 for threads outside the pool
+    thread_local int queueIndex = 0;
+    thread_local const void *queueOwner = nullptr;
+}
+
+JobSystem::JobSystem(int workers) {
+    for (int i = 0; i <= workers; ++i) queues.push_back(std::make_unique<Queue>());
+    for (int i = 1; i <= workers; ++i) this->workers.emplace_back(&JobSystem::work, this, i);
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    jobAdded.notify_all();
+    for (auto &worker : workers) worker.join();
+}
+
+void JobSystem::run(Counter &counter, std::function<void()> job) {
+    counter.pending.fetch_add(1, std::memory_order_relaxed);
+    Job entry{std::move(job), &counter};
+    if (workers.empty()) {
+        execute(entry);
+        return;
+    }
+    Queue &queue = *queues[queueOwner == this ? queueIndex : 0];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(std::move(entry));
+    }
+    queued.fetch_add(1);
+    {
+        // a worker checking queued under this lock either sees the job or is already waiting for the notify
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    jobAdded.notify_one();
+}
+
+void JobSystem::wait(Counter &counter) {
+    while (counter.pending.load(std::memory_order_acquire) > 0) {
+        Job job;
+        if (next(job)) execute(job);
+        else std::this_thread::yield();
+    }
+}
+
+void JobSystem::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &body) {
+    if (count == 0) return;
+    // a few chunks per thread, so a slow one can be balanced by stealing the rest
+    size_t chunks = std::min(count / std::max<size_t>(1, grain), size_t(threadCount()) * 4);
+    if (chunks <= 1 || workers.empty()) {
+        body(0, count);
+        return;
+    }
+    Counter counter;
+    size_t size = (count + chunks - 1) / chunks;
+    for (size_t begin = size; begin < count; begin += size) {
+        size_t end = std::min(count, begin + size);
+        run(counter, [&body, begin, end] { body(begin, end); });
+    }
+    body(0, std::min(count, size));
+    wait(counter);
+}
+
+bool JobSystem::next(Job &job) {
+    int own = queueOwner == this ? queueIndex : 0;
+    {
+        Queue &queue = *queues[own];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty()) {
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues.size(); ++i) {
+        Queue &queue = *queues[(own + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty()) {
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::execute(Job &job) {
+    job.work();
+    job.counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::work(int index) {
+    queueIndex = index;
+    queueOwner = this;
+    while (true) {
+        Job job;
+        if (next(job)) {
+            execute(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        jobAdded.wait(lock, [this] { return stopping || queued.load() > 0; });
+        if (stopping) return;
+    }
+}
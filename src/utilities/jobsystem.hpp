@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fork / join jobs for the per-frame scene work, each thread has its own deque.
+// A thread pushes and pops the back of its own deque, idle threads steal from the front of the others',
+// so a subtree stays on the thread that split it until someone runs dry.
+// Threads outside the pool, the main thread, share deque 0 and run jobs while they wait.
+class JobSystem {
+public:
+    // unfinished jobs run against it, wait on it to join them
+    struct Counter {
+        std::atomic<int> pending{0};
+    };
+
+    // 0 workers runs every job on the calling thread right away
+    explicit JobSystem(int workers);
+    ~JobSystem();
+
+    void run(Counter &counter, std::function<void()> job);
+    // runs queued jobs on this thread until counter reaches zero
+    void wait(Counter &counter);
+    // body(begin, end) over [0, count) in chunks of at least grain items, returns when all of them are done
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &body);
+    // workers plus the calling thread
+    int threadCount() const { return int(workers.size()) + 1; }
+
+private:
+    struct Job {
+        std::function<void()> work;
+        Counter *counter = nullptr;
+    };
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    // own deque first, then the others
+    bool next(Job &job);
+    void execute(Job &job);
+    void work(int index);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<int> queued{0};
+    std::atomic<bool> stopping{false};
+    std::mutex sleepMutex;
+    std::condition_variable jobAdded;
+};
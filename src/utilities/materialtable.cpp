@@ -0,0 +1,178 @@
+#include "materialtable.hpp"
+#include "resourcecache.hpp"
+#include "shader_uniform_defines.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+
+bool Material::operator==(const Material &other) const {
+    return std::equal(std::begin(textures), std::end(textures), std::begin(other.textures))
+        && flags == other.flags && fur_length == other.fur_length;
+}
+
+MaterialTable::MaterialTable() {
+    materials.emplace_back();
+}
+
+GLuint MaterialTable::add(const Material &material) {
+    auto found = std::find(materials.begin(), materials.end(), material);
+    if (found != materials.end()) return GLuint(found - materials.begin());
+    materials.push_back(material);
+    return GLuint(materials.size() - 1);
+}
+
+void MaterialTable::clear() {
+    materials.resize(1);
+    // ids of deleted textures get handed out again
+    constantColors.clear();
+}
+
+void MaterialTable::upload(bool bindless) {
+    release();
+    useBindless = bindless;
+
+    std::vector<MaterialData> data(materials.size());
+    for (size_t i = 0; i < materials.size(); ++i) {
+        data[i].flags = materials[i].flags;
+        data[i].fur_length = materials[i].fur_length;
+        for (int slot = 0; slot < MATERIAL_SLOTS; ++slot) {
+            GLuint texture = materials[i].textures[slot];
+            GLuint color = 0;
+            if (constantColor(texture, color)) {
+                data[i].textures[slot] = color;
+                data[i].flags |= MATERIAL_FLAG_CONSTANT_SLOT << slot;
+            } else if (useBindless) {
+                data[i].textures[slot] = residentHandle(texture);
+            }
+        }
+    }
+    if (!useBindless) buildArrays(data);
+
+    GLsizeiptr size = GLsizeiptr(data.size() * sizeof(MaterialData));
+    if (size != bufferSize) {
+        if (buffer != 0) glDeleteBuffers(1, &buffer);
+        glCreateBuffers(1, &buffer);
+        glNamedBufferStorage(buffer, size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+        bufferSize = size;
+    }
+    glNamedBufferSubData(buffer, 0, size, data.data());
+}
+
+void MaterialTable::bind() const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BINDING, buffer);
+    if (useBindless) return;
+    for (int i = 0; i < MATERIAL_ARRAYS; ++i) glBindTextureUnit(MATERIAL_ARRAY_SAMPLER + i, arrays[i]);
+}
+
+bool MaterialTable::constantColor(GLuint texture, GLuint &color) {
+    if (texture == 0) {
+        color = 0xffffffff;
+        return true;
+    }
+    auto found = constantColors.find(texture);
+    if (found != constantColors.end()) {
+        color = found->second;
+        return true;
+    }
+    GLint width = 0, height = 0;
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_HEIGHT, &height);
+    if (width != 1 || height != 1) return false;
+
+    unsigned char texel[4] = {};
+    glGetTextureImage(texture, 0, GL_RGBA, GL_UNSIGNED_BYTE, sizeof(texel), texel);
+    // red in the low byte, the order unpackUnorm4x8 reads
+    color = GLuint(texel[0]) | GLuint(texel[1]) << 8 | GLuint(texel[2]) << 16 | GLuint(texel[3]) << 24;
+    constantColors[texture] = color;
+    return true;
+}
+
+GLuint64 MaterialTable::residentHandle(GLuint texture) {
+    // sampler state is frozen from here on
+    GLuint64 handle = glGetTextureHandleARB(texture);
+    if (!glIsTextureHandleResidentARB(handle)) {
+        glMakeTextureHandleResidentARB(handle);
+        resident.push_back(handle);
+    }
+    return handle;
+}
+
+void MaterialTable::buildArrays(std::vector<MaterialData> &data) {
+    struct Placement {
+        int array;
+        GLsizei layer;
+        GLsizei width;
+        GLsizei height;
+    };
+    // every texture once, in the smallest array it fits, bigger ones are scaled down into the last
+    std::map<GLuint, Placement> placements;
+    GLsizei layers[MATERIAL_ARRAYS] = {};
+    for (size_t i = 0; i < materials.size(); ++i) {
+        for (int slot = 0; slot < MATERIAL_SLOTS; ++slot) {
+            GLuint texture = materials[i].textures[slot];
+            if ((data[i].flags & MATERIAL_FLAG_CONSTANT_SLOT << slot) || placements.count(texture)) continue;
+            Placement placement{0, 0, 0, 0};
+            glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_WIDTH, &placement.width);
+            glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_HEIGHT, &placement.height);
+            GLsizei largest = std::max(placement.width, placement.height);
+            while (placement.array + 1 < MATERIAL_ARRAYS && (MIN_ARRAY_SIZE << placement.array) < largest) {
+                placement.array++;
+            }
+            placement.layer = layers[placement.array]++;
+            placements[texture] = placement;
+        }
+    }
+
+    for (int i = 0; i < MATERIAL_ARRAYS; ++i) {
+        if (layers[i] == 0) continue;
+        GLsizei size = MIN_ARRAY_SIZE << i;
+        GLsizei levels = 1;
+        while ((size >> levels) > 0) levels++;
+        glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &arrays[i]);
+        glTextureStorage3D(arrays[i], levels, GL_RGBA8, size, size, layers[i]);
+        arrayBytes += mipmappedBytes(size, size) * layers[i];
+        glTextureParameteri(arrays[i], GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTextureParameteri(arrays[i], GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    // non-square textures are stretched to fill the layer, uvs stay the same
+    GLuint framebuffers[2];
+    glCreateFramebuffers(2, framebuffers);
+    for (const auto &entry : placements) {
+        const Placement &placement = entry.second;
+        GLsizei size = MIN_ARRAY_SIZE << placement.array;
+        // read a mip level at most twice the size, a single bilinear tap skips texels beyond that.
+        // Material textures are mipmapped, see ResourceCache::texture
+        GLint level = 0;
+        while (std::max(placement.width, placement.height) >> (level + 1) >= 2 * size) level++;
+        glNamedFramebufferTexture(framebuffers[0], GL_COLOR_ATTACHMENT0, entry.first, level);
+        glNamedFramebufferTextureLayer(framebuffers[1], GL_COLOR_ATTACHMENT0, arrays[placement.array], 0,
+                                       placement.layer);
+        glBlitNamedFramebuffer(framebuffers[0], framebuffers[1],
+                               0, 0, std::max(1, placement.width >> level), std::max(1, placement.height >> level),
+                               0, 0, size, size, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    }
+    glDeleteFramebuffers(2, framebuffers);
+    for (GLuint array : arrays) {
+        if (array != 0) glGenerateTextureMipmap(array);
+    }
+
+    for (size_t i = 0; i < materials.size(); ++i) {
+        for (int slot = 0; slot < MATERIAL_SLOTS; ++slot) {
+            if (data[i].flags & MATERIAL_FLAG_CONSTANT_SLOT << slot) continue;
+            const Placement &placement = placements[materials[i].textures[slot]];
+            data[i].textures[slot] = GLuint64(placement.array) | GLuint64(placement.layer) << 32;
+        }
+    }
+}
+
+void MaterialTable::release() {
+    for (GLuint64 handle : resident) glMakeTextureHandleNonResidentARB(handle);
+    resident.clear();
+    for (GLuint &array : arrays) {
+        if (array != 0) glDeleteTextures(1, &array);
+        array = 0;
+    }
+    arrayBytes = 0;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <map>
+#include <vector>
+
+// Texture slots of a material, the same order as MaterialData::textures in material.glsl
+enum MaterialSlot {
+    MATERIAL_COLOR,
+    MATERIAL_NORMAL,
+    MATERIAL_ROUGHNESS,
+    MATERIAL_FUR,
+    MATERIAL_TURBULENCE,
+    MATERIAL_SLOTS
+};
+
+struct Material {
+    // 0 leaves the slot white, a 1x1 texture is inlined as a color
+    GLuint textures[MATERIAL_SLOTS] = {};
+    // MATERIAL_FLAG_ bits of shader_uniform_defines.hpp
+    GLuint flags = 0;
+    float fur_length = 0;
+
+    bool operator==(const Material &other) const;
+};
+
+// std430 layout of the Materials buffer in material.glsl.
+// A texture is a bindless handle, or the material array in the low word and the layer in the high word.
+// Slots flagged MATERIAL_FLAG_CONSTANT_SLOT hold the color of a one texel texture in the low word instead.
+struct MaterialData {
+    GLuint64 textures[MATERIAL_SLOTS];
+    GLuint flags;
+    float fur_length;
+};
+static_assert(sizeof(MaterialData) == 48, "MaterialData must match the shader side stride");
+
+// Every material of the scene in one storage buffer, so shaders find their textures by material index
+// and nothing has to be bound between draws.
+// With GL_ARB_bindless_texture and GL_NV_gpu_shader5 the buffer holds resident texture handles. Without them
+// every texture is scaled into a layer of one of MATERIAL_ARRAYS texture arrays, one per power of two size,
+// which stay bound.
+// Textures of a single texel, see ResourceCache::texture, are not sampled at all.
+class MaterialTable {
+public:
+    static const int MATERIAL_ARRAYS = 6;
+    // the smallest array, each next one doubles
+    static const GLsizei MIN_ARRAY_SIZE = 64;
+
+    // no gl calls, it can be a global
+    MaterialTable();
+
+    // index of the material, equal materials share one. Index 0 is the untextured default
+    GLuint add(const Material &material);
+    // makes the textures resident or copies them into the arrays, then writes the buffer.
+    // Materials added afterwards need another upload
+    void upload(bool bindless);
+    // the buffer at MATERIAL_BINDING and the arrays at MATERIAL_ARRAY_SAMPLER onwards
+    void bind() const;
+    bool bindless() const { return useBindless; }
+    size_t size() const { return materials.size(); }
+    const Material &material(GLuint index) const { return materials[index]; }
+    // back to only the default material, before the scene registers its materials again
+    void clear();
+    // the buffer and the texture arrays
+    GLsizeiptr bytes() const { return bufferSize + arrayBytes; }
+
+private:
+    // the packed RGBA8 color of 1x1 textures, white for no texture
+    bool constantColor(GLuint texture, GLuint &color);
+    GLuint64 residentHandle(GLuint texture);
+    void buildArrays(std::vector<MaterialData> &data);
+    void release();
+
+    std::vector<Material> materials;
+    bool useBindless = false;
+    GLuint buffer = 0;
+    GLsizeiptr bufferSize = 0;
+    std::map<GLuint, GLuint> constantColors;
+    GLuint arrays[MATERIAL_ARRAYS] = {};
+    GLsizeiptr arrayBytes = 0;
+    std::vector<GLuint64> resident;
+};
@@ -0,0 +1,151 @@
+#include "meshpool.hpp"
+#include "drawstats.hpp"
+#include "glutils.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+MeshPool mesh_pool;
+
+// starting sizes, the buffers double when a mesh does not fit
+const GLsizeiptr INITIAL_VERTEX_CAPACITY = 1 << 18;
+const GLsizeiptr INITIAL_INDEX_CAPACITY = 1 << 18;
+
+// Creates a buffer of newSize bytes holding the first usedSize bytes of the old one
+static GLuint regrowBuffer(GLuint oldBufferID, GLsizeiptr usedSize, GLsizeiptr newSize) {
+    GLuint bufferID;
+    glCreateBuffers(1, &bufferID);
+    glNamedBufferData(bufferID, newSize, nullptr, GL_STATIC_DRAW);
+    if (oldBufferID != 0) {
+        if (usedSize > 0) glCopyNamedBufferSubData(oldBufferID, bufferID, 0, 0, usedSize);
+        glDeleteBuffers(1, &oldBufferID);
+    }
+    return bufferID;
+}
+
+void MeshPool::initialize() {
+    glCreateVertexArrays(1, &vaoID);
+
+    glEnableVertexArrayAttrib(vaoID, 0);
+    glVertexArrayAttribFormat(vaoID, 0, 3, GL_FLOAT, GL_FALSE, offsetof(PooledVertex, position));
+    glVertexArrayAttribBinding(vaoID, 0, 0);
+
+    glEnableVertexArrayAttrib(vaoID, 1);
+    glVertexArrayAttribFormat(vaoID, 1, 3, GL_FLOAT, GL_TRUE, offsetof(PooledVertex, normal));
+    glVertexArrayAttribBinding(vaoID, 1, 0);
+
+    glEnableVertexArrayAttrib(vaoID, 2);
+    glVertexArrayAttribFormat(vaoID, 2, 2, GL_FLOAT, GL_FALSE, offsetof(PooledVertex, uv));
+    glVertexArrayAttribBinding(vaoID, 2, 0);
+
+    glEnableVertexArrayAttrib(vaoID, 3);
+    glVertexArrayAttribFormat(vaoID, 3, 3, GL_FLOAT, GL_TRUE, offsetof(PooledVertex, tangent));
+    glVertexArrayAttribBinding(vaoID, 3, 0);
+
+    reserve(INITIAL_VERTEX_CAPACITY, INITIAL_INDEX_CAPACITY);
+}
+
+void MeshPool::reserve(GLsizeiptr vertices, GLsizeiptr indices) {
+    if (vertices > vertexCapacity) {
+        GLsizeiptr newCapacity = std::max(vertices, 2 * vertexCapacity);
+        vertexBufferID = regrowBuffer(vertexBufferID, vertexBytes(), newCapacity * sizeof(PooledVertex));
+        vertexCapacity = newCapacity;
+        glVertexArrayVertexBuffer(vaoID, 0, vertexBufferID, 0, sizeof(PooledVertex));
+    }
+    if (indices > indexCapacity) {
+        GLsizeiptr newCapacity = std::max(indices, 2 * indexCapacity);
+        indexBufferID = regrowBuffer(indexBufferID, indexBytes(), newCapacity * sizeof(GLuint));
+        indexCapacity = newCapacity;
+        glVertexArrayElementBuffer(vaoID, indexBufferID);
+    }
+}
+
+MeshRange MeshPool::allocate(Mesh &mesh) {
+    if (vaoID == 0) initialize();
+
+    std::vector<glm::vec3> tangents = generateTangents(mesh);
+    std::vector<PooledVertex> vertices(mesh.vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        vertices[i].position = mesh.vertices[i];
+        vertices[i].normal = i < mesh.normals.size() ? mesh.normals[i] : glm::vec3(0);
+        vertices[i].uv = i < mesh.textureCoordinates.size() ? mesh.textureCoordinates[i] : glm::vec2(0);
+        vertices[i].tangent = i < tangents.size() ? tangents[i] : glm::vec3(0);
+    }
+
+    // a released span if one fits, otherwise the buffers grow at the end of the used part
+    GLsizeiptr vertexEnd = vertexCount, indexEnd = indexCount;
+    GLsizeiptr vertexOffset = take(freeVertices, vertexEnd, vertices.size());
+    GLsizeiptr indexOffset = take(freeIndices, indexEnd, mesh.indices.size());
+    reserve(vertexEnd, indexEnd);
+    vertexCount = vertexEnd;
+    indexCount = indexEnd;
+
+    MeshRange range;
+    range.firstIndex = indexOffset;
+    range.indexCount = mesh.indices.size();
+    range.baseVertex = vertexOffset;
+    range.vertexCount = vertices.size();
+    range.bounds = computeBounds(mesh.vertices);
+    range.sphere = computeBoundingSphere(range.bounds, mesh.vertices);
+
+    // indices stay relative to the mesh, baseVertex offsets them at draw time
+    glNamedBufferSubData(vertexBufferID, vertexOffset * sizeof(PooledVertex),
+                         vertices.size() * sizeof(PooledVertex), vertices.data());
+    glNamedBufferSubData(indexBufferID, indexOffset * sizeof(GLuint),
+                         mesh.indices.size() * sizeof(GLuint), mesh.indices.data());
+
+    return range;
+}
+
+void MeshPool::release(const MeshRange &range) {
+    // glNamedBufferSubData is ordered after earlier draws, so the next allocate can overwrite it right away
+    if (range.vertexCount > 0) give(freeVertices, range.baseVertex, range.vertexCount);
+    if (range.indexCount > 0) give(freeIndices, range.firstIndex, range.indexCount);
+}
+
+GLsizeiptr MeshPool::take(std::vector<Span> &spans, GLsizeiptr &used, GLsizeiptr size) {
+    for (auto it = spans.begin(); it != spans.end(); ++it) {
+        if (it->size < size) continue;
+        GLsizeiptr offset = it->offset;
+        it->offset += size;
+        it->size -= size;
+        if (it->size == 0) spans.erase(it);
+        return offset;
+    }
+    GLsizeiptr offset = used;
+    used += size;
+    return offset;
+}
+
+void MeshPool::give(std::vector<Span> &spans, GLsizeiptr offset, GLsizeiptr size) {
+    auto it = std::lower_bound(spans.begin(), spans.end(), offset,
+                               [](const Span &span, GLsizeiptr offset) { return span.offset < offset; });
+    it = spans.insert(it, {offset, size});
+    auto next = it + 1;
+    if (next != spans.end() && it->offset + it->size == next->offset) {
+        it->size += next->size;
+        spans.erase(next);
+    }
+    if (it != spans.begin()) {
+        auto previous = it - 1;
+        if (previous->offset + previous->size == it->offset) {
+            previous->size += it->size;
+            spans.erase(it);
+        }
+    }
+}
+
+void MeshPool::bind() {
+    glBindVertexArray(vaoID);
+}
+
+DrawElementsIndirectCommand MeshPool::command(const MeshRange &range, GLuint baseInstance) const {
+    return {GLuint(range.indexCount), 1, range.firstIndex, range.baseVertex, baseInstance};
+}
+
+void MeshPool::draw(const MeshRange &range) {
+    glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+                             (void*)(range.firstIndex * sizeof(GLuint)), range.baseVertex);
+    draw_stats.count();
+}
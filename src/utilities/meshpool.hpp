@@ -0,0 +1,81 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "mesh.hpp"
+#include "bounds.hpp"
+
+#include <vector>
+
+// Where a mesh lives inside the shared geometry buffers
+struct MeshRange {
+    GLuint firstIndex = 0;
+    GLsizei indexCount = 0;
+    GLint baseVertex = 0;
+    GLsizei vertexCount = 0;
+    // model-space bounds, computed when the mesh is allocated
+    AABB bounds;
+    BoundingSphere sphere;
+};
+
+// Record layout consumed by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Interleaved vertex, attribute locations match the ones generateBuffer uses
+struct PooledVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 uv;
+    glm::vec3 tangent;
+};
+
+// Suballocates every static mesh into one vertex buffer and one index buffer behind a single VAO,
+// so pooled draws never have to switch vertex arrays.
+// Released ranges go on a free list that later meshes are fitted into before the buffers grow.
+class MeshPool {
+public:
+    MeshRange allocate(Mesh &mesh);
+    // the range may be handed out again, draws already submitted still read the old contents
+    void release(const MeshRange &range);
+    void bind();
+    DrawElementsIndirectCommand command(const MeshRange &range, GLuint baseInstance = 0) const;
+    void draw(const MeshRange &range);
+
+    GLuint vao() const { return vaoID; }
+    // everything up to the highest range ever allocated, released ranges included
+    GLsizeiptr vertexBytes() const { return vertexCount * sizeof(PooledVertex); }
+    GLsizeiptr indexBytes() const { return indexCount * sizeof(GLuint); }
+    // both buffers as allocated
+    GLsizeiptr capacityBytes() const { return vertexCapacity * sizeof(PooledVertex) + indexCapacity * sizeof(GLuint); }
+
+private:
+    // unused elements [offset, offset + size), sorted by offset with neighbours merged
+    struct Span {
+        GLsizeiptr offset;
+        GLsizeiptr size;
+    };
+
+    void initialize();
+    void reserve(GLsizeiptr vertices, GLsizeiptr indices);
+    // the first free span of at least size elements, or the end of the used part
+    static GLsizeiptr take(std::vector<Span> &spans, GLsizeiptr &used, GLsizeiptr size);
+    static void give(std::vector<Span> &spans, GLsizeiptr offset, GLsizeiptr size);
+
+    GLuint vaoID = 0;
+    GLuint vertexBufferID = 0;
+    GLuint indexBufferID = 0;
+    GLsizeiptr vertexCount = 0;
+    GLsizeiptr indexCount = 0;
+    GLsizeiptr vertexCapacity = 0;
+    GLsizeiptr indexCapacity = 0;
+    std::vector<Span> freeVertices;
+    std::vector<Span> freeIndices;
+};
+
+extern MeshPool mesh_pool;
@@ -0,0 +1,160 @@
+#include "rendertargets.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+void RenderTargetManager::allocate(Target &target) {
+    if (target.textureID != 0) glDeleteTextures(1, &target.textureID);
+    if (target.samples > 1) {
+        // multisample textures have no sampler state, they are only read with texelFetch
+        glCreateTextures(GL_TEXTURE_2D_MULTISAMPLE, 1, &target.textureID);
+        glTextureStorage2DMultisample(target.textureID, target.samples, target.format, target.width, target.height, GL_TRUE);
+        return;
+    }
+    glCreateTextures(GL_TEXTURE_2D, 1, &target.textureID);
+    glTextureStorage2D(target.textureID, 1, target.format, target.width, target.height);
+    glTextureParameteri(target.textureID, GL_TEXTURE_MIN_FILTER, target.filter);
+    glTextureParameteri(target.textureID, GL_TEXTURE_MAG_FILTER, target.filter);
+    glTextureParameteri(target.textureID, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(target.textureID, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+bool RenderTargetManager::resize(int width, int height) {
+    // minimized windows report 0x0, keep the old targets until there is something to draw to
+    if (width <= 0 || height <= 0) return false;
+    framebufferWidth = width;
+    framebufferHeight = height;
+    return reallocate();
+}
+
+bool RenderTargetManager::setScale(float scale) {
+    renderScale = scale;
+    if (framebufferWidth == 0) return false;
+    return reallocate();
+}
+
+bool RenderTargetManager::reallocate() {
+    int width = std::max(1, int(framebufferWidth * renderScale));
+    int height = std::max(1, int(framebufferHeight * renderScale));
+    if (width == targetWidth && height == targetHeight) return false;
+    targetWidth = width;
+    targetHeight = height;
+
+    for (auto &target : persistent) {
+        target.width = std::max(1, int(width * target.scale));
+        target.height = std::max(1, int(height * target.scale));
+        allocate(target);
+    }
+    // pooled textures of the old size will not be asked for again
+    for (auto &target : transient) {
+        if (target.inUse) {
+            std::cerr << "Render target " << target.textureID << " still acquired during resize" << std::endl;
+        }
+        glDeleteTextures(1, &target.textureID);
+    }
+    transient.clear();
+    return true;
+}
+
+RenderTargetID RenderTargetManager::create(GLenum format, GLenum filter, float scale) {
+    Target target;
+    target.format = format;
+    target.filter = filter;
+    target.scale = scale;
+    if (targetWidth > 0) {
+        target.width = std::max(1, int(targetWidth * scale));
+        target.height = std::max(1, int(targetHeight * scale));
+        allocate(target);
+    }
+    persistent.push_back(target);
+    return RenderTargetID(persistent.size() - 1);
+}
+
+bool RenderTargetManager::setFormat(RenderTargetID target, GLenum format) {
+    Target &persistentTarget = persistent[target];
+    if (persistentTarget.format == format) return false;
+    persistentTarget.format = format;
+    if (persistentTarget.textureID == 0) return false;
+    allocate(persistentTarget);
+    return true;
+}
+
+bool RenderTargetManager::setSamples(RenderTargetID target, int samples) {
+    Target &persistentTarget = persistent[target];
+    if (persistentTarget.samples == samples) return false;
+    persistentTarget.samples = samples;
+    if (persistentTarget.textureID == 0) return false;
+    allocate(persistentTarget);
+    return true;
+}
+
+GLuint RenderTargetManager::texture(RenderTargetID target) const {
+    return persistent[target].textureID;
+}
+
+GLenum RenderTargetManager::format(RenderTargetID target) const {
+    return persistent[target].format;
+}
+
+int RenderTargetManager::samples(RenderTargetID target) const {
+    return persistent[target].samples;
+}
+
+int RenderTargetManager::width(RenderTargetID target) const {
+    return persistent[target].width;
+}
+
+int RenderTargetManager::height(RenderTargetID target) const {
+    return persistent[target].height;
+}
+
+GLuint RenderTargetManager::acquire(GLenum format, int width, int height, GLenum filter) {
+    for (auto &target : transient) {
+        if (!target.inUse && target.format == format && target.filter == filter
+            && target.width == width && target.height == height) {
+            target.inUse = true;
+            return target.textureID;
+        }
+    }
+    Target target;
+    target.format = format;
+    target.filter = filter;
+    target.width = width;
+    target.height = height;
+    target.inUse = true;
+    allocate(target);
+    transient.push_back(target);
+    return target.textureID;
+}
+
+void RenderTargetManager::release(GLuint texture) {
+    for (auto &target : transient) {
+        if (target.textureID == texture) {
+            target.inUse = false;
+            return;
+        }
+    }
+    std::cerr << "Released render target " << texture << " that was not acquired" << std::endl;
+}
+
+// bytes per texel of the formats the renderer uses, anything else counts as four
+static GLsizeiptr texelBytes(GLenum format) {
+    switch (format) {
+        case GL_RGBA32F: return 16;
+        case GL_RGBA16F: return 8;
+        case GL_R16F: return 2;
+        case GL_R8: return 1;
+        default: return 4;
+    }
+}
+
+GLsizeiptr RenderTargetManager::bytes() const {
+    GLsizeiptr total = 0;
+    for (const auto *targets : {&persistent, &transient}) {
+        for (const auto &target : *targets) {
+            if (target.textureID == 0) continue;
+            total += GLsizeiptr(target.width) * target.height * target.samples * texelBytes(target.format);
+        }
+    }
+    return total;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <vector>
+
+// Handle to a render target owned by a RenderTargetManager
+typedef int RenderTargetID;
+
+// Owns the offscreen textures the passes render into.
+// Persistent targets follow the render size and are recreated when it changes, so their texture ids change;
+// transient targets are borrowed for part of a frame and pooled by format and size.
+// The render size is the framebuffer size times a resolution scale.
+class RenderTargetManager {
+public:
+    // framebuffer size in pixels, returns true if the persistent targets were recreated
+    bool resize(int width, int height);
+    // per axis scale of the render size, returns true if the persistent targets were recreated
+    bool setScale(float scale);
+    // the size the scene is rendered at
+    int width() const { return targetWidth; }
+    int height() const { return targetHeight; }
+    // the size of the framebuffer it is presented to
+    int outputWidth() const { return framebufferWidth; }
+    int outputHeight() const { return framebufferHeight; }
+
+    // a target of scale times the framebuffer size, allocated now if the size is known
+    RenderTargetID create(GLenum format, GLenum filter = GL_LINEAR, float scale = 1.0f);
+    // changes the format of a persistent target, returns true if it was recreated
+    bool setFormat(RenderTargetID target, GLenum format);
+    // 1 for a plain 2D texture, more for a GL_TEXTURE_2D_MULTISAMPLE, returns true if it was recreated
+    bool setSamples(RenderTargetID target, int samples);
+    GLuint texture(RenderTargetID target) const;
+    GLenum format(RenderTargetID target) const;
+    int samples(RenderTargetID target) const;
+    int width(RenderTargetID target) const;
+    int height(RenderTargetID target) const;
+
+    // a pooled texture, hand it back with release when the pass is done with it
+    GLuint acquire(GLenum format, int width, int height, GLenum filter = GL_LINEAR);
+    void release(GLuint texture);
+
+    // every persistent and pooled target
+    GLsizeiptr bytes() const;
+
+private:
+    struct Target {
+        GLuint textureID = 0;
+        GLenum format = 0;
+        GLenum filter = GL_LINEAR;
+        float scale = 1.0f;
+        int samples = 1;
+        int width = 0;
+        int height = 0;
+        bool inUse = false;
+    };
+    static void allocate(Target &target);
+    bool reallocate();
+
+    std::vector<Target> persistent;
+    std::vector<Target> transient;
+    int targetWidth = 0;
+    int targetHeight = 0;
+    int framebufferWidth = 0;
+    int framebufferHeight = 0;
+    float renderScale = 1.0f;
+};
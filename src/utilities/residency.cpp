@@ -0,0 +1,165 @@
+#include "residency.hpp"
+
+#include <algorithm>
+#include <fmt/format.h>
+
+namespace {
+    GLsizei longest(const CachedTexture &texture) {
+        return std::max(texture.fileWidth, texture.fileHeight);
+    }
+
+    // mip level of the file that has size on its longer side
+    int levelOf(const CachedTexture &texture, GLsizei size) {
+        int level = 0;
+        while ((longest(texture) >> level) > size) level++;
+        return level;
+    }
+
+    // the smallest mip streaming goes down to
+    int lastLevel(const CachedTexture &texture) {
+        int level = 0;
+        while ((longest(texture) >> (level + 1)) >= ResidencyManager::MIN_SIZE) level++;
+        return level;
+    }
+
+    // the smallest mip that still has as many texels as are drawn
+    int wantedLevel(const CachedTexture &texture, float texels) {
+        int level = 0;
+        while (level < lastLevel(texture) && (longest(texture) >> (level + 1)) >= texels) level++;
+        return level;
+    }
+
+    GLsizeiptr levelBytes(const CachedTexture &texture, int level) {
+        return mipmappedBytes(std::max(1, texture.fileWidth >> level), std::max(1, texture.fileHeight >> level));
+    }
+}
+
+void ResidencyManager::beginFrame() {
+    byId.clear();
+    for (auto it = streams.begin(); it != streams.end();) {
+        if (it->second.texture.expired()) it = streams.erase(it);
+        else ++it;
+    }
+    for (const auto &texture : resource_cache.streamedTextures()) {
+        Stream &stream = streams[texture->filename];
+        stream.texture = texture;
+        stream.wanted = 0;
+        byId[texture->id] = &stream;
+    }
+}
+
+void ResidencyManager::request(GLuint texture, float texels) {
+    auto found = byId.find(texture);
+    if (found != byId.end()) found->second->wanted = std::max(found->second->wanted, texels);
+}
+
+void ResidencyManager::track(const std::string &name, GLsizeiptr bytes) {
+    tracked[name] = bytes;
+}
+
+bool ResidencyManager::update(GLsizeiptr budget) {
+    lastBudget = budget;
+    // replaced during the last update, the materials have been registered again since
+    resource_cache.deleteRetired();
+
+    bool replaced = false;
+    std::vector<Load> finished;
+    {
+        std::lock_guard<std::mutex> lock(loadedMutex);
+        finished.swap(loaded);
+    }
+    for (const auto &load : finished) {
+        auto texture = load.texture.lock();
+        if (!texture) continue;
+        auto stream = streams.find(texture->filename);
+        if (stream == streams.end()) continue;
+        stream->second.loading = false;
+        // the budget took mips away while it loaded, growing now would undo that
+        if (std::max(load.image.width, load.image.height) > (longest(*texture) >> stream->second.targetLevel)) continue;
+        resource_cache.replace(texture, load.image);
+        replaced = true;
+    }
+
+    // only grow without pressure, mips that are not needed right now may be again soon
+    GLsizeiptr total = totalBytes();
+    std::vector<std::pair<Stream*, TextureHandle>> live;
+    for (auto &entry : streams) {
+        Stream &stream = entry.second;
+        auto texture = stream.texture.lock();
+        if (!texture) continue;
+        int current = levelOf(*texture, std::max(texture->width, texture->height));
+        stream.targetLevel = std::min(current, wantedLevel(*texture, stream.wanted));
+        total += levelBytes(*texture, stream.targetLevel) - texture->bytes;
+        live.emplace_back(&stream, texture);
+    }
+
+    // the texture with the most texels per texel drawn gives up its top mip, until everything fits
+    while (budget > 0 && total > budget) {
+        std::pair<Stream*, TextureHandle> *victim = nullptr;
+        float victimExcess = 0;
+        for (auto &candidate : live) {
+            const Stream &stream = *candidate.first;
+            if (stream.targetLevel >= lastLevel(*candidate.second)) continue;
+            float excess = float(longest(*candidate.second) >> stream.targetLevel) / std::max(stream.wanted, 1.f);
+            if (excess > victimExcess) {
+                victim = &candidate;
+                victimExcess = excess;
+            }
+        }
+        if (!victim) break;
+        Stream &stream = *victim->first;
+        total -= levelBytes(*victim->second, stream.targetLevel) - levelBytes(*victim->second, stream.targetLevel + 1);
+        stream.targetLevel++;
+    }
+
+    for (auto &entry : live) {
+        Stream &stream = *entry.first;
+        const TextureHandle &texture = entry.second;
+        int current = levelOf(*texture, std::max(texture->width, texture->height));
+        GLsizei size = longest(*texture) >> stream.targetLevel;
+        if (stream.targetLevel > current) {
+            resource_cache.shrink(texture, size);
+            replaced = true;
+        } else if (stream.targetLevel < current && !stream.loading) {
+            if (!loader) loader = std::make_unique<ThreadPool>(1);
+            stream.loading = true;
+            std::weak_ptr<const CachedTexture> weak = texture;
+            std::string filename = texture->filename;
+            loader->submit([this, weak, filename, size] {
+                PNGImage image = loadPNGFile(filename);
+                shrinkPNGImage(image, size);
+                std::lock_guard<std::mutex> lock(loadedMutex);
+                loaded.push_back({weak, std::move(image)});
+            });
+        }
+    }
+    return replaced;
+}
+
+GLsizeiptr ResidencyManager::totalBytes() const {
+    GLsizeiptr total = resource_cache.textureBytes();
+    for (const auto &entry : tracked) total += entry.second;
+    return total;
+}
+
+size_t ResidencyManager::loading() const {
+    size_t count = 0;
+    for (const auto &entry : streams) count += entry.second.loading;
+    return count;
+}
+
+void ResidencyManager::report(std::ostream &out) const {
+    const double MiB = 1024. * 1024.;
+    out << fmt::format("{:.1f} MiB", totalBytes() / MiB);
+    if (lastBudget > 0) out << fmt::format(" of {:.1f} MiB", lastBudget / MiB);
+    out << fmt::format(", textures {:.1f} MiB", resource_cache.textureBytes() / MiB);
+    for (const auto &entry : tracked) out << fmt::format(", {} {:.1f} MiB", entry.first, entry.second / MiB);
+    out << std::endl;
+    for (const auto &entry : streams) {
+        auto texture = entry.second.texture.lock();
+        if (!texture) continue;
+        out << fmt::format("  {:4}x{:<4} of {:4}x{:<4} drawn at {:5.0f} texels{}  {}",
+                           texture->width, texture->height, texture->fileWidth, texture->fileHeight,
+                           entry.second.wanted, entry.second.loading ? ", loading" : "", entry.first) << std::endl;
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "resourcecache.hpp"
+#include "threadpool.hpp"
+
+// Keeps streamed textures of the resource_cache at the resolution they are seen at, within a memory budget.
+// Culling reports how many texels each visible texture spans on screen. A texture drawn larger than it is
+// resident is read from its file again on a loader thread and replaced a few frames later. Over budget, the
+// textures drawn smallest compared to what they have resident, those off screen first, lose their top mips.
+// Besides the cached textures it counts whatever else owners report with track, that counts against the budget
+// but is never evicted.
+class ResidencyManager {
+public:
+    // streamed textures never go below this on their longer side
+    static const GLsizei MIN_SIZE = 64;
+
+    // forgets the previous frame's requests and picks up newly loaded or released streamed textures
+    void beginFrame();
+    // the texture is drawn across about texels on its longer side, ids of unstreamed textures are ignored
+    void request(GLuint texture, float texels);
+    // gpu memory of something besides the cached textures, replaces what was tracked under the name before
+    void track(const std::string &name, GLsizeiptr bytes);
+    // starts loads and drops mips so everything fits in budget bytes, 0 for no limit.
+    // Returns true when a texture got a new id, materials have to be registered again before drawing
+    bool update(GLsizeiptr budget);
+
+    // cached textures plus everything tracked
+    GLsizeiptr totalBytes() const;
+    // textures waiting for the loader thread
+    size_t loading() const;
+    void report(std::ostream &out) const;
+
+private:
+    struct Stream {
+        std::weak_ptr<const CachedTexture> texture;
+        // texels asked for this frame, the largest request wins
+        float wanted = 0;
+        // the mip of the file it should have as level 0, what is wanted unless the budget says otherwise
+        int targetLevel = 0;
+        bool loading = false;
+    };
+    struct Load {
+        std::weak_ptr<const CachedTexture> texture;
+        PNGImage image;
+    };
+
+    std::map<std::string, Stream> streams;
+    std::map<GLuint, Stream*> byId;
+    std::map<std::string, GLsizeiptr> tracked;
+    GLsizeiptr lastBudget = 0;
+    // filled by the loader thread
+    std::mutex loadedMutex;
+    std::vector<Load> loaded;
+    // last, so it finishes its jobs before what they write to goes away
+    std::unique_ptr<ThreadPool> loader;
+};
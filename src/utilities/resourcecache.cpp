@@ -0,0 +1,313 @@
+#include "resourcecache.hpp"
+#include "imageLoader.hpp"
+#include "cpuprofiler.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <fmt/format.h>
+
+ResourceCache resource_cache;
+
+namespace {
+    template<class T>
+    std::shared_ptr<T> find(const std::map<std::string, std::weak_ptr<T>> &cache, const std::string &key) {
+        auto found = cache.find(key);
+        return found != cache.end() ? found->second.lock() : nullptr;
+    }
+
+    bool hasTransparency(const PNGImage &image) {
+        for (size_t i = 3; i < image.pixels.size(); i += 4) {
+            if (image.pixels[i] == 0) return true;
+        }
+        return false;
+    }
+
+    // maps of a single color are kept as one texel, the material table inlines those
+    bool makeConstant(PNGImage &image) {
+        if (image.pixels.empty()) return false;
+        for (size_t i = 4; i < image.pixels.size(); i += 4) {
+            if (!std::equal(&image.pixels[i], &image.pixels[i] + 4, image.pixels.begin())) return false;
+        }
+        image.width = image.height = 1;
+        image.pixels.resize(4);
+        return true;
+    }
+
+    // mutable storage, so shrink can copy out of it
+    GLuint upload2D(const PNGImage &image) {
+        GLuint id = 0;
+        glGenTextures(1, &id);
+        glBindTexture(GL_TEXTURE_2D, id);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return id;
+    }
+
+    GLuint uploadCubemap(const std::vector<PNGImage> &faces, GLsizeiptr &bytes) {
+        GLuint id = 0;
+        glGenTextures(1, &id);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+        bytes = 0;
+        for (size_t i = 0; i < faces.size(); ++i) {
+            const PNGImage &face = faces[i];
+            glTexImage2D(GLenum(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i), 0, GL_RGB, face.width, face.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, face.pixels.data());
+            // drivers pad RGB8 to four bytes
+            bytes += GLsizeiptr(face.width) * face.height * 4;
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        return id;
+    }
+}
+
+GLsizeiptr mipmappedBytes(GLsizei width, GLsizei height) {
+    GLsizeiptr bytes = 0;
+    while (true) {
+        bytes += GLsizeiptr(width) * height * 4;
+        if (width <= 1 && height <= 1) return bytes;
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+}
+
+TextureHandle ResourceCache::texture(const std::string &filename) {
+    return load("texture " + filename, filename, 0);
+}
+
+TextureHandle ResourceCache::streamedTexture(const std::string &filename, GLsizei size) {
+    return load("streamed " + filename, filename, size);
+}
+
+TextureHandle ResourceCache::load(const std::string &key, const std::string &filename, GLsizei size) {
+    if (auto cached = find(textures, key)) return cached;
+
+    PROFILE_ZONE("load texture");
+    auto tex = loadPNGFile(filename);
+    CachedTexture texture;
+    texture.filename = filename;
+    texture.fileWidth = tex.width;
+    texture.fileHeight = tex.height;
+    texture.has_transparency = hasTransparency(tex);
+    if (!makeConstant(tex) && size > 0) {
+        texture.streamed = true;
+        shrinkPNGImage(tex, size);
+    }
+    texture.id = upload2D(tex);
+    texture.width = tex.width;
+    texture.height = tex.height;
+    texture.bytes = mipmappedBytes(tex.width, tex.height);
+    return share(key, texture);
+}
+
+TextureHandle ResourceCache::cubemap(const std::string &foldername) {
+    std::string key = "cubemap " + foldername;
+    if (auto cached = find(textures, key)) return cached;
+
+    PROFILE_ZONE("load cubemap");
+    CachedTexture texture;
+    texture.target = GL_TEXTURE_CUBE_MAP;
+    texture.filename = foldername;
+    auto faces = readImages(GL_TEXTURE_CUBE_MAP, foldername);
+    texture.id = uploadCubemap(faces, texture.bytes);
+    texture.width = texture.fileWidth = faces.back().width;
+    texture.height = texture.fileHeight = faces.back().height;
+    return share(key, texture);
+}
+
+MeshHandle ResourceCache::mesh(const std::string &filename) {
+    return mesh("obj " + filename, [&filename] { return Mesh(filename); });
+}
+
+MeshHandle ResourceCache::mesh(const std::string &key, const std::function<Mesh()> &generate) {
+    if (auto cached = find(meshes, key)) return cached;
+
+    PROFILE_ZONE("load mesh");
+    Mesh m = generate();
+    CachedMesh mesh;
+    mesh.range = mesh_pool.allocate(m);
+    mesh.bytes = mesh.range.vertexCount * GLsizeiptr(sizeof(PooledVertex)) + mesh.range.indexCount * GLsizeiptr(sizeof(GLuint));
+    return share(key, mesh);
+}
+
+TextureHandle ResourceCache::share(const std::string &key, CachedTexture texture) {
+    textureTotal += texture.bytes;
+    std::shared_ptr<CachedTexture> handle(new CachedTexture(texture), [this, key](CachedTexture *texture) {
+        glDeleteTextures(1, &texture->id);
+        textureTotal -= texture->bytes;
+        textures.erase(key);
+        delete texture;
+    });
+    textures[key] = handle;
+    return handle;
+}
+
+MeshHandle ResourceCache::share(const std::string &key, CachedMesh mesh) {
+    meshTotal += mesh.bytes;
+    MeshHandle handle(new CachedMesh(mesh), [this, key](const CachedMesh *mesh) {
+        mesh_pool.release(mesh->range);
+        meshTotal -= mesh->bytes;
+        meshes.erase(key);
+        delete mesh;
+    });
+    meshes[key] = handle;
+    return handle;
+}
+
+std::vector<TextureHandle> ResourceCache::streamedTextures() const {
+    std::vector<TextureHandle> streamed;
+    for (const auto &texture : textures) {
+        auto handle = texture.second.lock();
+        if (handle && handle->streamed) streamed.push_back(handle);
+    }
+    return streamed;
+}
+
+void ResourceCache::shrink(const TextureHandle &texture, GLsizei size) {
+    GLint level = 0;
+    while (std::max(texture->width, texture->height) >> level > size) level++;
+    if (level == 0) return;
+    GLsizei width = std::max(1, texture->width >> level);
+    GLsizei height = std::max(1, texture->height >> level);
+    GLsizei levels = 1;
+    while (std::max(width, height) >> levels > 0) levels++;
+
+    GLuint id = 0;
+    glCreateTextures(GL_TEXTURE_2D, 1, &id);
+    glTextureStorage2D(id, levels, GL_RGBA8, width, height);
+    for (GLint i = 0; i < levels; ++i) {
+        glCopyImageSubData(texture->id, GL_TEXTURE_2D, level + i, 0, 0, 0,
+                           id, GL_TEXTURE_2D, i, 0, 0, 0,
+                           std::max(1, width >> i), std::max(1, height >> i), 1);
+    }
+    glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    exchange(texture, id, width, height, mipmappedBytes(width, height));
+}
+
+void ResourceCache::replace(const TextureHandle &texture, const PNGImage &image) {
+    if (image.pixels.empty()) return;
+    GLsizei levels = 1;
+    while (std::max(image.width, image.height) >> levels > 0) levels++;
+
+    GLuint id = 0;
+    glCreateTextures(GL_TEXTURE_2D, 1, &id);
+    glTextureStorage2D(id, levels, GL_RGBA8, image.width, image.height);
+    glTextureSubImage2D(id, 0, 0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+    glGenerateTextureMipmap(id);
+    glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    exchange(texture, id, image.width, image.height, mipmappedBytes(image.width, image.height));
+}
+
+std::vector<TextureHandle> ResourceCache::texturesFrom(const std::string &filename) const {
+    std::vector<TextureHandle> found;
+    for (const auto &texture : textures) {
+        auto handle = texture.second.lock();
+        if (!handle) continue;
+        bool folder = handle->target == GL_TEXTURE_CUBE_MAP;
+        if (folder ? filename.compare(0, handle->filename.size(), handle->filename) == 0 : filename == handle->filename) {
+            found.push_back(handle);
+        }
+    }
+    return found;
+}
+
+std::vector<PNGImage> ResourceCache::readImages(GLenum target, const std::string &filename) {
+    if (target != GL_TEXTURE_CUBE_MAP) return {loadPNGFile(filename)};
+    std::vector<PNGImage> faces;
+    for (const char *face : {"posx.png", "negx.png", "negy.png", "posy.png", "posz.png", "negz.png"}) {
+        faces.push_back(loadPNGFile(filename + face));
+    }
+    return faces;
+}
+
+bool ResourceCache::reload(const TextureHandle &texture, std::vector<PNGImage> images) {
+    auto entry = mutableEntry(texture);
+    if (!entry) return false;
+    for (const auto &image : images) {
+        if (image.pixels.empty()) {
+            std::cerr << "Could not reload " << texture->filename << ", keeping what was loaded" << std::endl;
+            return false;
+        }
+    }
+    PROFILE_ZONE("reload texture");
+    if (texture->target == GL_TEXTURE_CUBE_MAP) {
+        GLsizeiptr bytes = 0;
+        GLuint id = uploadCubemap(images, bytes);
+        entry->fileWidth = images.back().width;
+        entry->fileHeight = images.back().height;
+        exchange(texture, id, images.back().width, images.back().height, bytes);
+        return true;
+    }
+    PNGImage &image = images.front();
+    entry->fileWidth = image.width;
+    entry->fileHeight = image.height;
+    entry->has_transparency = hasTransparency(image);
+    if (texture->streamed) {
+        shrinkPNGImage(image, std::max(texture->width, texture->height));
+    } else {
+        makeConstant(image);
+    }
+    exchange(texture, upload2D(image), image.width, image.height, mipmappedBytes(image.width, image.height));
+    return true;
+}
+
+std::shared_ptr<CachedTexture> ResourceCache::mutableEntry(const TextureHandle &texture) const {
+    for (const auto &entry : textures) {
+        auto handle = entry.second.lock();
+        if (handle && handle == texture) return handle;
+    }
+    return nullptr;
+}
+
+void ResourceCache::exchange(const TextureHandle &texture, GLuint id, GLsizei width, GLsizei height, GLsizeiptr bytes) {
+    auto entry = mutableEntry(texture);
+    if (!entry) {
+        glDeleteTextures(1, &id);
+        return;
+    }
+    retired.push_back(entry->id);
+    textureTotal -= entry->bytes;
+    entry->id = id;
+    entry->width = width;
+    entry->height = height;
+    entry->bytes = bytes;
+    textureTotal += entry->bytes;
+}
+
+void ResourceCache::deleteRetired() {
+    if (retired.empty()) return;
+    glDeleteTextures(GLsizei(retired.size()), retired.data());
+    retired.clear();
+}
+
+void ResourceCache::report(std::ostream &out) const {
+    const double MiB = 1024. * 1024.;
+    out << fmt::format("{} textures {:.2f} MiB, {} meshes {:.2f} MiB",
+                       textures.size(), textureTotal / MiB, meshes.size(), meshTotal / MiB) << std::endl;
+
+    struct Entry {
+        const std::string *key;
+        GLsizeiptr bytes;
+        long users;
+    };
+    std::vector<Entry> entries;
+    for (const auto &texture : textures) {
+        long users = texture.second.use_count();
+        if (auto handle = texture.second.lock()) entries.push_back({&texture.first, handle->bytes, users});
+    }
+    for (const auto &mesh : meshes) {
+        long users = mesh.second.use_count();
+        if (auto handle = mesh.second.lock()) entries.push_back({&mesh.first, handle->bytes, users});
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.bytes > b.bytes; });
+    for (const auto &entry : entries) {
+        out << fmt::format("  {:9.3f} MiB  {} users  {}", entry.bytes / MiB, entry.users, *entry.key) << std::endl;
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "meshpool.hpp"
+#include "imageLoader.hpp"
+
+struct CachedTexture {
+    // streamed textures get a new id whenever their resolution changes and any texture when its file is
+    // reloaded, so don't hold on to it
+    GLuint id = 0;
+    GLenum target = GL_TEXTURE_2D;
+    // of the resident level 0
+    GLsizei width = 0;
+    GLsizei height = 0;
+    // some texels are fully transparent, the opaque pass has to alpha test it
+    bool has_transparency = false;
+    // every level and face as uploaded
+    GLsizeiptr bytes = 0;
+    // resized by the ResidencyManager, the file is read again to grow it
+    bool streamed = false;
+    // the png, or the folder of a cubemap
+    std::string filename;
+    // of the png, or of one cubemap face
+    GLsizei fileWidth = 0;
+    GLsizei fileHeight = 0;
+};
+
+struct CachedMesh {
+    MeshRange range;
+    GLsizeiptr bytes = 0;
+};
+
+// a full RGBA8 mip chain, what the cache counts for 2D textures
+GLsizeiptr mipmappedBytes(GLsizei width, GLsizei height);
+
+// Shared handles, the gpu object is freed when the last one goes away
+using TextureHandle = std::shared_ptr<const CachedTexture>;
+using MeshHandle = std::shared_ptr<const CachedMesh>;
+
+// the current id, 0 for no texture
+inline GLuint textureName(const TextureHandle &texture) { return texture ? texture->id : 0; }
+
+// Loads every texture and mesh once, keyed by path and how it is loaded, and hands out shared handles.
+// Asking again while a handle is alive returns the same object, so a model instanced a hundred times
+// is read, decoded and uploaded once. Meshes go into the shared mesh_pool.
+// Only use it on the thread that owns the context.
+class ResourceCache {
+public:
+    // a png as a mipmapped 2D texture, a single color image becomes one texel, see MaterialTable
+    TextureHandle texture(const std::string &filename);
+    // the same, but only up to size texels on the longer side for now. Single color images are never streamed
+    TextureHandle streamedTexture(const std::string &filename, GLsizei size);
+    // posx.png, negx.png and so on from the folder
+    TextureHandle cubemap(const std::string &foldername);
+    // an obj file
+    MeshHandle mesh(const std::string &filename);
+    // a generated mesh, key has to name the generator and everything it was given
+    MeshHandle mesh(const std::string &key, const std::function<Mesh()> &generate);
+
+    size_t textureCount() const { return textures.size(); }
+    size_t meshCount() const { return meshes.size(); }
+    GLsizeiptr textureBytes() const { return textureTotal; }
+    GLsizeiptr meshBytes() const { return meshTotal; }
+    // what is loaded and how much memory it takes, largest first
+    void report(std::ostream &out) const;
+
+    // Streaming, these put a new texture object behind the handle. Materials have to be registered again
+    // and the old object stays alive until deleteRetired
+    std::vector<TextureHandle> streamedTextures() const;
+    // keeps the mips from where the longer side is size down, nothing is read from disk
+    void shrink(const TextureHandle &texture, GLsizei size);
+    // the image as level 0 with a full mip chain, it should be the texture's file shrunk by shrinkPNGImage
+    void replace(const TextureHandle &texture, const PNGImage &image);
+    // once nothing uses the ids shrink, replace and reload took out of use any more
+    void deleteRetired();
+
+    // Hot reload. Every loaded texture that comes from the file, cubemaps from any file of their folder
+    std::vector<TextureHandle> texturesFrom(const std::string &filename) const;
+    // the image, or the six faces, as the texture is read from its filename. Only reads files, any thread can
+    static std::vector<PNGImage> readImages(GLenum target, const std::string &filename);
+    // puts what readImages returned behind the handle, a streamed texture stays at its current resolution.
+    // False when an image failed to read, the texture stays as it was
+    bool reload(const TextureHandle &texture, std::vector<PNGImage> images);
+
+private:
+    TextureHandle load(const std::string &key, const std::string &filename, GLsizei size);
+    TextureHandle share(const std::string &key, CachedTexture texture);
+    MeshHandle share(const std::string &key, CachedMesh mesh);
+    // the cache's own writable entry of a handle it gave out
+    std::shared_ptr<CachedTexture> mutableEntry(const TextureHandle &texture) const;
+    // swaps in the new object and its size
+    void exchange(const TextureHandle &texture, GLuint id, GLsizei width, GLsizei height, GLsizeiptr bytes);
+
+    // mutable here, handed out as const
+    std::map<std::string, std::weak_ptr<CachedTexture>> textures;
+    std::map<std::string, std::weak_ptr<const CachedMesh>> meshes;
+    GLsizeiptr textureTotal = 0;
+    GLsizeiptr meshTotal = 0;
+    std::vector<GLuint> retired;
+};
+
+extern ResourceCache resource_cache;
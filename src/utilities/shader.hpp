@@ -1,8 +1,13 @@
 #pragma once
 
 #include <glad/glad.h>
+#include <cassert>
 #include <fstream>
+#include <memory>
 #include <string>
+#include <vector>
+
+#include "cpuprofiler.hpp"
 
 
 namespace Gloom
@@ -16,6 +21,15 @@ namespace Gloom
         GLint  mStatus;
         GLint  mLength;
 
+        // What attach was given, for rebuild
+        struct Source
+        {
+            std::string filename;
+            std::string defines;
+            GLenum type;
+        };
+        std::vector<Source> mSources;
+
     public:
         Shader() {
             mProgram = glCreateProgram();
@@ -27,39 +41,21 @@ namespace Gloom
         GLuint get()        { return mProgram; }
         void   destroy()    { glDeleteProgram(mProgram); }
 
-        /* Attach a shader to the current shader program */
-        void attach(std::string const &filename)
+        /* Attach a shader to the current shader program,
+           defines are inserted as lines right after the #version line.
+           The stage comes from the file extension unless type is given,
+           so a shared .glsl file can be linked into several stages */
+        void attach(std::string const &filename, std::string const &defines = "", GLenum type = 0)
         {
-            // Load GLSL Shader from source
-            std::ifstream fd(filename.c_str());
-            if (fd.fail())
-            {
-                fprintf(stderr,
-                    "Something went wrong when attaching the Shader file at \"%s\".\n"
-                    "The file may not exist or is currently inaccessible.\n",
-                    filename.c_str());
-                return;
-            }
-            auto src = std::string(std::istreambuf_iterator<char>(fd),
-                                  (std::istreambuf_iterator<char>()));
-
-            // Create shader object
-            const char * source = src.c_str();
-            auto shader = create(filename);
-            glShaderSource(shader, 1, &source, nullptr);
-            glCompileShader(shader);
-
-            // Display errors
-            glGetShaderiv(shader, GL_COMPILE_STATUS, &mStatus);
-            if (!mStatus)
-            {
-                glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &mLength);
-                std::unique_ptr<char[]> buffer(new char[mLength]);
-                glGetShaderInfoLog(shader, mLength, nullptr, buffer.get());
-                fprintf(stderr, "%s\n%s", filename.c_str(), buffer.get());
-            }
+            PROFILE_ZONE("compile shader");
+            mSources.push_back({filename, defines, type});
+            std::string log;
+            auto shader = compile(mSources.back(), log);
+            mStatus = shader != 0;
+            if (!mStatus) fprintf(stderr, "%s", log.c_str());
 
             assert(mStatus);
+            if (!mStatus) return;
 
             // Attach shader and free allocated memory
             glAttachShader(mProgram, shader);
@@ -70,20 +66,57 @@ namespace Gloom
         /* Links all attached shaders together into a shader program */
         void link()
         {
-            // Link all attached shaders
-            glLinkProgram(mProgram);
+            PROFILE_ZONE("link shader");
+            std::string log;
+            mStatus = linkProgram(mProgram, log);
+            if (!mStatus) fprintf(stderr, "%s", log.c_str());
 
-            // Display errors
-            glGetProgramiv(mProgram, GL_LINK_STATUS, &mStatus);
-            if (!mStatus)
+            assert(mStatus);
+        }
+
+
+        /* True if filename was attached, as the same path */
+        bool uses(std::string const &filename) const
+        {
+            for (auto const &source : mSources)
+                if (source.filename == filename) return true;
+            return false;
+        }
+
+
+        /* Compiles and links the attached files again as they are on disk now.
+           Returns the new program, or 0 with the errors in log. Touches no
+           state of this object, so it can run on a thread with a shared context */
+        GLuint rebuild(std::string &log) const
+        {
+            PROFILE_ZONE("rebuild shader");
+            GLuint program = glCreateProgram();
+            for (auto const &source : mSources)
             {
-                glGetProgramiv(mProgram, GL_INFO_LOG_LENGTH, &mLength);
-                std::unique_ptr<char[]> buffer(new char[mLength]);
-                glGetProgramInfoLog(mProgram, mLength, nullptr, buffer.get());
-                fprintf(stderr, "%s\n", buffer.get());
+                auto shader = compile(source, log);
+                if (shader == 0)
+                {
+                    glDeleteProgram(program);
+                    return 0;
+                }
+                glAttachShader(program, shader);
+                glDeleteShader(shader);
+            }
+            if (!linkProgram(program, log))
+            {
+                glDeleteProgram(program);
+                return 0;
             }
+            return program;
+        }
 
-            assert(mStatus);
+
+        /* Takes over a program from rebuild, the old one is deleted.
+           Uniform locations are explicit, so nothing else has to change */
+        void replace(GLuint program)
+        {
+            glDeleteProgram(mProgram);
+            mProgram = program;
         }
 
 
@@ -125,7 +158,7 @@ namespace Gloom
 
 
         /* Helper function for creating shaders */
-        GLuint create(std::string const &filename)
+        static GLuint create(std::string const &filename)
         {
             // Extract file extension and create the correct shader type
             auto idx = filename.rfind(".");
@@ -139,6 +172,65 @@ namespace Gloom
             else                    return false;
         }
 
+    private:
+        // Reads, prepares and compiles one stage, 0 with the errors appended to log on failure
+        static GLuint compile(Source const &source, std::string &log)
+        {
+            // Load GLSL Shader from source
+            std::ifstream fd(source.filename.c_str());
+            if (fd.fail())
+            {
+                log += "Something went wrong when attaching the Shader file at \"" + source.filename + "\".\n"
+                       "The file may not exist or is currently inaccessible.\n";
+                return 0;
+            }
+            auto src = std::string(std::istreambuf_iterator<char>(fd),
+                                  (std::istreambuf_iterator<char>()));
+            if (!source.defines.empty())
+            {
+                auto versionEnd = src.find('\n') + 1;
+                src.insert(versionEnd, source.defines + "\n");
+            }
+
+            // Create shader object
+            const char * text = src.c_str();
+            auto shader = source.type != 0 ? glCreateShader(source.type) : create(source.filename);
+            glShaderSource(shader, 1, &text, nullptr);
+            glCompileShader(shader);
+
+            // Collect errors
+            GLint status, length;
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+            if (!status)
+            {
+                glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+                std::unique_ptr<char[]> buffer(new char[length]);
+                glGetShaderInfoLog(shader, length, nullptr, buffer.get());
+                log += source.filename + "\n" + buffer.get();
+                glDeleteShader(shader);
+                return 0;
+            }
+            return shader;
+        }
+
+        // Links program, false with the errors appended to log
+        static bool linkProgram(GLuint program, std::string &log)
+        {
+            // Link all attached shaders
+            glLinkProgram(program);
+
+            GLint status, length;
+            glGetProgramiv(program, GL_LINK_STATUS, &status);
+            if (!status)
+            {
+                glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+                std::unique_ptr<char[]> buffer(new char[length]);
+                glGetProgramInfoLog(program, length, nullptr, buffer.get());
+                log += std::string(buffer.get()) + "\n";
+            }
+            return status;
+        }
+
     private:
         // Disable copying and assignment
         Shader(Shader const &) = delete;
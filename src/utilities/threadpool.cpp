@@ -0,0 +1,52 @@
+#include "threadpool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threads) {
+    if (threads <= 0) threads = std::max(1, int(std::thread::hardware_concurrency()) - 1);
+    for (int i = 0; i < threads; ++i) workers.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAdded.notify_all();
+    for (auto &worker : workers) worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    jobAdded.notify_one();
+}
+
+void ThreadPool::waitUntil(size_t count) {
+    std::unique_lock<std::mutex> lock(mutex);
+    jobDone.wait(lock, [this, count] { return jobs.size() + running <= count; });
+}
+
+size_t ThreadPool::pending() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return jobs.size() + running;
+}
+
+void ThreadPool::work() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        jobAdded.wait(lock, [this] { return stopping || !jobs.empty(); });
+        // the queue is drained before stopping, so nothing submitted is lost
+        if (jobs.empty()) return;
+        auto job = std::move(jobs.front());
+        jobs.pop_front();
+        running++;
+        lock.unlock();
+        job();
+        lock.lock();
+        running--;
+        jobDone.notify_all();
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads taking jobs from one queue, for cpu work that must stay off the render thread
+class ThreadPool {
+public:
+    // 0 picks one thread less than the hardware has, at least one
+    explicit ThreadPool(int threads = 0);
+    // finishes every queued job first
+    ~ThreadPool();
+
+    void submit(std::function<void()> job);
+    // blocks until the queue is empty and no job is running
+    void wait() { waitUntil(0); }
+    // blocks until at most count jobs are queued or running
+    void waitUntil(size_t count);
+    // queued plus running jobs
+    size_t pending();
+    int threadCount() const { return int(workers.size()); }
+
+private:
+    void work();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAdded;
+    std::condition_variable jobDone;
+    size_t running = 0;
+    bool stopping = false;
+};